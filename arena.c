@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2013 Kay Sievers
+ * Copyright (C) 2013 Greg Kroah-Hartman <gregkh@linuxfoundation.org>
+ * Copyright (C) 2013 Daniel Mack <daniel@zonque.org>
+ * Copyright (C) 2013 Linux Foundation
+ *
+ * kdbus is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ */
+
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include "arena.h"
+#include "pool.h"
+#include "util.h"
+
+/**
+ * struct kdbus_arena - shared memory for broadcast payload data
+ * @pool:		The memory of the arena, managed like a pool
+ *
+ * The payload of a broadcast message is written to the arena once, and all
+ * receivers which have the arena mapped get an item pointing to the data,
+ * instead of a copy of it in their own pool. The data is released when the
+ * last receiver frees its message. Receivers can only map the arena
+ * read-only; unlike their own pool, the arena is shared with all other
+ * receivers on the bus.
+ */
+struct kdbus_arena {
+	struct kdbus_pool *pool;
+};
+
+/**
+ * kdbus_arena_new() - create a new arena
+ * @size:		Maximum size of the arena
+ * @arena:		Pointer location for the returned arena
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_arena_new(size_t size, struct kdbus_arena **arena)
+{
+	struct kdbus_arena *a;
+	int ret;
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if (!a)
+		return -ENOMEM;
+
+	ret = kdbus_pool_new("kdbus-arena", size, 0, &a->pool);
+	if (ret < 0) {
+		kfree(a);
+		return ret;
+	}
+
+	*arena = a;
+	return 0;
+}
+
+/**
+ * kdbus_arena_free() - destroy an arena
+ * @arena:		The arena to destroy, may be NULL
+ *
+ * All slices of the arena must have been released.
+ */
+void kdbus_arena_free(struct kdbus_arena *arena)
+{
+	if (!arena)
+		return;
+
+	kdbus_pool_free(arena->pool);
+	kfree(arena);
+}
+
+/**
+ * kdbus_arena_size() - the size of the arena
+ * @arena:		The arena
+ *
+ * Return: the size of the arena
+ */
+size_t kdbus_arena_size(const struct kdbus_arena *arena)
+{
+	return kdbus_pool_size(arena->pool);
+}
+
+/**
+ * kdbus_arena_mmap() - map the arena into the process
+ * @arena:		The arena
+ * @vma:		passed by mmap() syscall
+ * @off:		The mmap() offset the arena is mapped at
+ *
+ * Return: the result of the mmap() call, negative errno on failure.
+ */
+int kdbus_arena_mmap(const struct kdbus_arena *arena,
+		     struct vm_area_struct *vma, size_t off)
+{
+	/* the arena is shared, never allow to make it writable later */
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	/* map the arena from its start, not at the offset behind the pool */
+	vma->vm_pgoff -= off >> PAGE_SHIFT;
+
+	return kdbus_pool_mmap(arena->pool, vma);
+}
+
+/**
+ * kdbus_arena_slice_new() - store data in the arena
+ * @arena:		The arena
+ * @data:		The data to store
+ * @size:		The size of the data
+ * @slice:		Pointer location for the returned slice
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_arena_slice_new(struct kdbus_arena *arena, void *data, size_t size,
+			  struct kdbus_arena_slice **slice)
+{
+	struct kdbus_arena_slice *s;
+	ssize_t n;
+	int ret;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	ret = kdbus_pool_alloc_range(arena->pool, size, &s->off);
+	if (ret < 0)
+		goto exit_free;
+
+	n = kdbus_pool_write(arena->pool, s->off, data, size);
+	if (n < 0) {
+		ret = n;
+		goto exit_pool_free;
+	}
+
+	/* the data is written once, and read by all receivers from now on */
+	kdbus_pool_flush_dcache(arena->pool, s->off, size);
+
+	kref_init(&s->kref);
+	s->arena = arena;
+	s->size = size;
+
+	*slice = s;
+	return 0;
+
+exit_pool_free:
+	kdbus_pool_free_range(arena->pool, s->off);
+exit_free:
+	kfree(s);
+	return ret;
+}
+
+static void __kdbus_arena_slice_free(struct kref *kref)
+{
+	struct kdbus_arena_slice *slice =
+		container_of(kref, struct kdbus_arena_slice, kref);
+
+	kdbus_pool_free_range(slice->arena->pool, slice->off);
+	kfree(slice);
+}
+
+/**
+ * kdbus_arena_slice_ref() - take a slice reference
+ * @slice:		The slice
+ *
+ * Return: the slice itself
+ */
+struct kdbus_arena_slice *
+kdbus_arena_slice_ref(struct kdbus_arena_slice *slice)
+{
+	kref_get(&slice->kref);
+	return slice;
+}
+
+/**
+ * kdbus_arena_slice_unref() - drop a slice reference
+ * @slice:		The slice, may be NULL
+ *
+ * When the last reference is dropped, the data is released from the arena.
+ *
+ * Return: NULL
+ */
+struct kdbus_arena_slice *
+kdbus_arena_slice_unref(struct kdbus_arena_slice *slice)
+{
+	if (!slice)
+		return NULL;
+
+	kref_put(&slice->kref, __kdbus_arena_slice_free);
+	return NULL;
+}
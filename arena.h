@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2013 Kay Sievers
+ * Copyright (C) 2013 Greg Kroah-Hartman <gregkh@linuxfoundation.org>
+ * Copyright (C) 2013 Daniel Mack <daniel@zonque.org>
+ * Copyright (C) 2013 Linux Foundation
+ *
+ * kdbus is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ */
+
+#ifndef __KDBUS_ARENA_H
+#define __KDBUS_ARENA_H
+
+#include <linux/kref.h>
+
+struct kdbus_arena;
+
+/**
+ * struct kdbus_arena_slice - payload data stored in the arena
+ * @kref:		Reference counter, one for the message being sent and
+ *			one for every receiver's message pointing to the data
+ * @arena:		The arena the data is stored in
+ * @off:		Offset of the data in the arena
+ * @size:		Size of the data
+ */
+struct kdbus_arena_slice {
+	struct kref kref;
+	struct kdbus_arena *arena;
+	size_t off;
+	size_t size;
+};
+
+int kdbus_arena_new(size_t size, struct kdbus_arena **arena);
+void kdbus_arena_free(struct kdbus_arena *arena);
+size_t kdbus_arena_size(const struct kdbus_arena *arena);
+int kdbus_arena_mmap(const struct kdbus_arena *arena,
+		     struct vm_area_struct *vma, size_t off);
+
+int kdbus_arena_slice_new(struct kdbus_arena *arena, void *data, size_t size,
+			  struct kdbus_arena_slice **slice);
+struct kdbus_arena_slice *
+kdbus_arena_slice_ref(struct kdbus_arena_slice *slice);
+struct kdbus_arena_slice *
+kdbus_arena_slice_unref(struct kdbus_arena_slice *slice);
+#endif
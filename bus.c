@@ -12,21 +12,32 @@
 
 #include <linux/device.h>
 #include <linux/fs.h>
+#include <linux/hash.h>
 #include <linux/hashtable.h>
 #include <linux/idr.h>
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/random.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 
+#include "arena.h"
 #include "bus.h"
 #include "connection.h"
 #include "endpoint.h"
+#include "match.h"
 #include "names.h"
 #include "namespace.h"
+#include "rhash.h"
+
+/* the connection table is keyed by the full 64-bit ID */
+static inline u32 kdbus_bus_conn_hash(u64 id)
+{
+	return hash_64(id, 32);
+}
 
 bool kdbus_bus_uid_is_privileged(const struct kdbus_bus *bus)
 {
@@ -65,6 +76,9 @@ static void __kdbus_bus_free(struct kref *kref)
 
 	if (bus->name_registry)
 		kdbus_name_registry_free(bus->name_registry);
+	kdbus_match_index_free(bus->match_index);
+	kdbus_arena_free(bus->arena);
+	kdbus_rhash_destroy(&bus->conn_hash);
 	kdbus_ns_unref(bus->ns);
 	kfree(bus->name);
 	kfree(bus);
@@ -97,21 +111,115 @@ struct kdbus_bus *kdbus_bus_unref(struct kdbus_bus *bus)
  * is ref'ed, and needs to be unref'ed by the user. Returns NULL if
  * the connection can't be found.
  *
- * This function must be called with bus->lock held.
+ * The connection table is searched under rcu_read_lock(), the bus lock
+ * is not needed.
  */
 struct kdbus_conn *kdbus_bus_find_conn_by_id(struct kdbus_bus *bus, u64 id)
 {
 	struct kdbus_conn *conn, *found = NULL;
+	struct kdbus_rhash_table *t;
 
-	hash_for_each_possible(bus->conn_hash, conn, hentry, id)
-		if (conn->id == id) {
-			found = kdbus_conn_ref(conn);
+	rcu_read_lock();
+	t = rcu_dereference(bus->conn_hash.table);
+	kdbus_rhash_for_each_possible_rcu(t, conn, hentry,
+					  kdbus_bus_conn_hash(id)) {
+		if (conn->id != id)
+			continue;
+
+		found = kdbus_conn_ref_rcu(conn);
+		break;
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+
+/**
+ * kdbus_bus_find_conn_next() - find the next connection in the order of IDs
+ * @bus:		The bus to look for the connection
+ * @conn:		The connection to continue after, or NULL
+ * @id:			The lowest ID to return if @conn is NULL or no
+ *			longer on the bus
+ *
+ * Walks the connections of a bus in the order of their IDs without holding
+ * the bus lock between the steps. The returned connection is ref'ed, and
+ * needs to be unref'ed by the user. Returns NULL if there is no further
+ * connection.
+ */
+struct kdbus_conn *kdbus_bus_find_conn_next(struct kdbus_bus *bus,
+					    struct kdbus_conn *conn, u64 id)
+{
+	struct kdbus_conn *c, *found = NULL;
+	struct kdbus_rhash_table *t;
+
+	mutex_lock(&bus->lock);
+	if (conn && !list_empty(&conn->bus_entry)) {
+		if (!list_is_last(&conn->bus_entry, &bus->conn_list))
+			found = list_next_entry(conn, bus_entry);
+		goto exit_unlock;
+	}
+
+	/* usually, the connection with the ID itself still exists */
+	t = kdbus_rhash_table(&bus->conn_hash);
+	kdbus_rhash_for_each_possible(t, c, hentry, kdbus_bus_conn_hash(id))
+		if (c->id == id) {
+			found = c;
+			goto exit_unlock;
+		}
+
+	list_for_each_entry(c, &bus->conn_list, bus_entry)
+		if (c->id >= id) {
+			found = c;
 			break;
 		}
 
+exit_unlock:
+	if (found)
+		found = kdbus_conn_ref(found);
+	mutex_unlock(&bus->lock);
+
 	return found;
 }
 
+/**
+ * kdbus_bus_conn_add() - link a connection into its bus
+ * @bus:		The bus
+ * @conn:		The connection, with its ID assigned
+ *
+ * This function must be called with bus->lock held.
+ */
+void kdbus_bus_conn_add(struct kdbus_bus *bus, struct kdbus_conn *conn)
+{
+	struct kdbus_conn *c;
+
+	/*
+	 * IDs are assigned before the connections are set up, so they are
+	 * not necessarily linked in order; the place is almost always at
+	 * the tail though.
+	 */
+	list_for_each_entry_reverse(c, &bus->conn_list, bus_entry)
+		if (c->id < conn->id)
+			break;
+	list_add(&conn->bus_entry, &c->bus_entry);
+
+	kdbus_rhash_add(&bus->conn_hash, &conn->hentry,
+			kdbus_bus_conn_hash(conn->id));
+}
+
+/**
+ * kdbus_bus_conn_del() - unlink a connection from its bus
+ * @bus:		The bus
+ * @conn:		The connection
+ *
+ * The connection stays valid for lookups under RCU which still found it.
+ * This function must be called with bus->lock held.
+ */
+void kdbus_bus_conn_del(struct kdbus_bus *bus, struct kdbus_conn *conn)
+{
+	list_del_init(&conn->bus_entry);
+	kdbus_rhash_del(&bus->conn_hash, &conn->hentry);
+}
+
 /**
  * kdbus_bus_disconnect() - disconnect a bus
  * @bus:		The kdbus reference
@@ -212,14 +320,19 @@ int kdbus_bus_new(struct kdbus_ns *ns,
 	b->bus_flags = make->flags;
 	b->bloom_size = bloom_size;
 	mutex_init(&b->lock);
-	hash_init(b->conn_hash);
+	INIT_LIST_HEAD(&b->conn_list);
 	INIT_LIST_HEAD(&b->ep_list);
 	INIT_LIST_HEAD(&b->monitors_list);
 	atomic64_set(&b->conn_seq_last, 0);
+	atomic_set(&b->arena_users, 0);
 
 	/* generate unique bus id */
 	generate_random_uuid(b->id128);
 
+	ret = kdbus_rhash_init(&b->conn_hash, &b->lock);
+	if (ret < 0)
+		goto exit;
+
 	b->name = kstrdup(name, GFP_KERNEL);
 	if (!b->name) {
 		ret = -ENOMEM;
@@ -230,6 +343,16 @@ int kdbus_bus_new(struct kdbus_ns *ns,
 	if (ret < 0)
 		goto exit;
 
+	ret = kdbus_match_index_new(bloom_size, &b->match_index);
+	if (ret < 0)
+		goto exit;
+
+	if (b->bus_flags & KDBUS_MAKE_ARENA) {
+		ret = kdbus_arena_new(KDBUS_BUS_ARENA_SIZE, &b->arena);
+		if (ret < 0)
+			goto exit;
+	}
+
 	ret = kdbus_ep_new(b, ns, "bus", mode, uid, gid,
 			   b->bus_flags & KDBUS_MAKE_POLICY_OPEN);
 	if (ret < 0)
@@ -16,6 +16,7 @@
 #include <linux/hashtable.h>
 #include <linux/idr.h>
 
+#include "rhash.h"
 #include "util.h"
 
 /**
@@ -29,12 +30,17 @@
  * @lock:		Bus data lock
  * @ep_seq_last:	Last used endpoint id sequence number
  * @conn_seq_last:	Last used connection id sequence number
- * @conn_idr:		Map of connection device minor nummbers
- * @conn_hash:		Map of connection IDs
+ * @conn_hash:		Hash table of the connections, keyed by their IDs
+ *			and looked up under RCU
+ * @conn_list:		Connections on this bus, in the order of their IDs
  * @ep_list:		Endpoints on this bus
  * @bus_flags:		Simple pass-through flags from userspace to userspace
  * @bloom_size:		Bloom filter size
  * @name_registry:	Namespace's list of buses
+ * @match_index:	Index of the match entries of all connections
+ * @arena:		Shared memory for broadcast payloads, if the bus was
+ *			created with KDBUS_MAKE_ARENA
+ * @arena_users:	Number of connections receiving payloads in @arena
  * @ns_entry:		Namespace's list of buses
  * @monitors_list:	Connections that monitor this bus
  * @id128:		Unique random 128 bit ID of this bus
@@ -56,12 +62,15 @@ struct kdbus_bus {
 	struct mutex lock;
 	u64 ep_seq_last;
 	atomic64_t conn_seq_last;
-	struct idr conn_idr;
-	DECLARE_HASHTABLE(conn_hash, 8);
+	struct kdbus_rhash conn_hash;
+	struct list_head conn_list;
 	struct list_head ep_list;
 	u64 bus_flags;
 	size_t bloom_size;
 	struct kdbus_name_registry *name_registry;
+	struct kdbus_match_index *match_index;
+	struct kdbus_arena *arena;
+	atomic_t arena_users;
 	struct list_head ns_entry;
 	struct list_head monitors_list;
 	u8 id128[16];
@@ -79,4 +88,8 @@ void kdbus_bus_disconnect(struct kdbus_bus *bus);
 
 bool kdbus_bus_uid_is_privileged(const struct kdbus_bus *bus);
 struct kdbus_conn *kdbus_bus_find_conn_by_id(struct kdbus_bus *bus, u64 id);
+struct kdbus_conn *kdbus_bus_find_conn_next(struct kdbus_bus *bus,
+					    struct kdbus_conn *conn, u64 id);
+void kdbus_bus_conn_add(struct kdbus_bus *bus, struct kdbus_conn *conn);
+void kdbus_bus_conn_del(struct kdbus_bus *bus, struct kdbus_conn *conn);
 #endif
@@ -10,12 +10,16 @@
  * your option) any later version.
  */
 
+#include <linux/capability.h>
 #include <linux/device.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/completion.h>
+#include <linux/cred.h>
 #include <linux/hashtable.h>
 #include <linux/idr.h>
 #include <linux/init.h>
+#include <linux/log2.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
@@ -25,7 +29,9 @@
 #include <linux/slab.h>
 #include <linux/syscalls.h>
 #include <linux/security.h>
+#include <linux/workqueue.h>
 
+#include "arena.h"
 #include "bus.h"
 #include "connection.h"
 #include "endpoint.h"
@@ -37,8 +43,19 @@
 #include "namespace.h"
 #include "notify.h"
 #include "policy.h"
+#include "pool.h"
+#include "ring.h"
 #include "util.h"
 
+static unsigned int kdbus_conn_broadcast_batch = KDBUS_CONN_BROADCAST_BATCH;
+module_param_named(broadcast_batch, kdbus_conn_broadcast_batch, uint, 0644);
+MODULE_PARM_DESC(broadcast_batch,
+		 "Minimum number of broadcast receivers per CPU to deliver "
+		 "in parallel, 0 to disable");
+
+/* number of receivers a delivery worker takes at once */
+#define KDBUS_CONN_FANOUT_CHUNK	16
+
 /**
  * struct kdbus_conn_reply_entry - an entry of kdbus_conn's list of replies
  * @entry:		The list_head entry of the connection's reply_from_list
@@ -234,12 +251,33 @@ exit_unref:
 	return ret;
 }
 
+/**
+ * struct kdbus_conn_arena_ref - a message in the pool using the arena
+ * @hentry:		Entry in the connection's arena_refs hash
+ * @off:		Offset of the message in the receiver's pool
+ * @slice:		The arena slice the message's payload items point to
+ */
+struct kdbus_conn_arena_ref {
+	struct hlist_node hentry;
+	size_t off;
+	struct kdbus_arena_slice *slice;
+};
+
+/*
+ * Add the PAYLOAD items to the staged message header, and copy the vector
+ * data directly to the receiver's pool; from the sender's memory, or with
+ * a single write from the kernel copy if the message carries one. With an
+ * arena slice, the items point into the arena and nothing is copied.
+ */
 static int kdbus_conn_payload_add(struct kdbus_conn *conn,
 				  struct kdbus_conn_queue *queue,
 				  const struct kdbus_kmsg *kmsg,
-				  size_t off, size_t items, size_t vec_data)
+				  const struct kdbus_arena_slice *arena,
+				  void *stage, size_t off, size_t items,
+				  size_t vec_data)
 {
 	const struct kdbus_item *item;
+	size_t vec_start = vec_data;
 	int ret;
 
 	if (kmsg->memfds_count > 0) {
@@ -257,73 +295,88 @@ static int kdbus_conn_payload_add(struct kdbus_conn *conn,
 	KDBUS_ITEM_FOREACH(item, &kmsg->msg, items) {
 		switch (item->type) {
 		case KDBUS_ITEM_PAYLOAD_VEC: {
-			char tmp[KDBUS_ITEM_HEADER_SIZE +
-				 sizeof(struct kdbus_vec)];
-			struct kdbus_item *it = (struct kdbus_item *)tmp;
+			struct kdbus_item *it = stage + items;
 
 			/* add item */
 			it->type = KDBUS_ITEM_PAYLOAD_OFF;
-			it->size = sizeof(tmp);
+			it->size = KDBUS_ITEM_HEADER_SIZE +
+				   sizeof(struct kdbus_vec);
 
 			/* a NULL address specifies a \0-bytes record */
-			if (KDBUS_PTR(item->vec.address))
-				it->vec.offset = vec_data;
-			else
+			if (!KDBUS_PTR(item->vec.address))
 				it->vec.offset = ~0ULL;
+			else if (arena)
+				it->vec.offset = arena->off +
+						 vec_data - vec_start;
+			else
+				it->vec.offset = vec_data;
 			it->vec.size = item->vec.size;
-			ret = kdbus_pool_write(conn->pool, off + items,
-					       it, it->size);
-			if (ret < 0)
-				return ret;
 			items += KDBUS_ALIGN8(it->size);
 
+			if (arena) {
+				it->type = KDBUS_ITEM_PAYLOAD_ARENA;
+				if (KDBUS_PTR(item->vec.address))
+					vec_data += item->vec.size;
+				else
+					vec_data += item->vec.size % 8;
+				break;
+			}
+
 			/* \0-bytes record */
 			if (!KDBUS_PTR(item->vec.address)) {
 				size_t pad = item->vec.size % 8;
+				u64 zero = 0;
 
 				if (pad == 0)
 					break;
 
+				/* the kernel copy has the bytes zeroed */
+				if (kmsg->vecs) {
+					vec_data += pad;
+					break;
+				}
+
 				/*
 				 * Preserve the alignment for the next payload
 				 * record in the output buffer; write as many
 				 * null-bytes to the buffer which the \0-bytes
 				 * record would have shifted the alignment.
 				 */
-				kdbus_pool_write_user(conn->pool,
-						      off + vec_data,
-						      (char __user *)
-							"\0\0\0\0\0\0\0", pad);
+				ret = kdbus_pool_write(conn->pool,
+						       off + vec_data,
+						       &zero, pad);
+				if (ret < 0)
+					return ret;
+
 				vec_data += pad;
 				break;
 			}
 
 			/* copy kdbus_vec data from sender to receiver */
-			ret = kdbus_pool_write_user(conn->pool, off + vec_data,
-				KDBUS_PTR(item->vec.address), item->vec.size);
-			if (ret < 0)
-				return ret;
+			if (!kmsg->vecs) {
+				ret = kdbus_pool_write_user(conn->pool,
+						off + vec_data,
+						KDBUS_PTR(item->vec.address),
+						item->vec.size);
+				if (ret < 0)
+					return ret;
+			}
 
 			vec_data += item->vec.size;
 			break;
 		}
 
 		case KDBUS_ITEM_PAYLOAD_MEMFD: {
-			char tmp[KDBUS_ITEM_HEADER_SIZE +
-				 sizeof(struct kdbus_memfd)];
-			struct kdbus_item *it = (struct kdbus_item *)tmp;
+			struct kdbus_item *it = stage + items;
 			struct file *fp;
 			size_t memfd;
 
 			/* add item */
 			it->type = KDBUS_ITEM_PAYLOAD_MEMFD;
-			it->size = sizeof(tmp);
+			it->size = KDBUS_ITEM_HEADER_SIZE +
+				   sizeof(struct kdbus_memfd);
 			it->memfd.size = item->memfd.size;
 			it->memfd.fd = -1;
-			ret = kdbus_pool_write(conn->pool, off + items,
-					       it, it->size);
-			if (ret < 0)
-				return ret;
 
 			/* grab reference of incoming file */
 			ret = kdbus_conn_memfd_ref(item, &fp);
@@ -348,9 +401,41 @@ static int kdbus_conn_payload_add(struct kdbus_conn *conn,
 		}
 	}
 
+	if (kmsg->vecs && !arena) {
+		ret = kdbus_pool_write(conn->pool, off + vec_start,
+				       kmsg->vecs, vec_data - vec_start);
+		if (ret < 0)
+			return ret;
+	}
+
 	return 0;
 }
 
+/*
+ * Get the receiver's staging buffer, in which the message header and all
+ * items are built before they are copied to the pool with a single write.
+ * The caller must hold the connection lock.
+ */
+static void *kdbus_conn_stage(struct kdbus_conn *conn, size_t size)
+{
+	if (size > conn->stage_size) {
+		size_t stage_size = roundup_pow_of_two(size);
+		void *stage;
+
+		stage = kmalloc(stage_size, GFP_KERNEL);
+		if (!stage)
+			return NULL;
+
+		kfree(conn->stage);
+		conn->stage = stage;
+		conn->stage_size = stage_size;
+	}
+
+	/* do not pass uninitialized padding bytes to the receiver */
+	memset(conn->stage, 0, size);
+	return conn->stage;
+}
+
 /* add queue entry to connection, maintain priority queue */
 static void kdbus_conn_queue_add(struct kdbus_conn *conn,
 				 struct kdbus_conn_queue *queue)
@@ -438,13 +523,19 @@ static void kdbus_conn_queue_cleanup(struct kdbus_conn_queue *queue)
 	kfree(queue);
 }
 
-/* enqueue a message into the receiver's pool */
-static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
-				   struct kdbus_kmsg *kmsg,
-				   struct kdbus_conn_reply_entry *reply,
-				   u64 *offset)
+/*
+ * Enqueue a message into the receiver's pool; the caller must hold the lock
+ * of the receiver, and wake it up after it released the lock.
+ */
+static int kdbus_conn_queue_insert_locked(struct kdbus_conn *conn,
+					  struct kdbus_kmsg *kmsg,
+					  struct kdbus_conn_reply_entry *reply,
+					  u64 *offset)
 {
+	struct kdbus_conn_arena_ref *arena_ref = NULL;
+	struct kdbus_arena_slice *arena = NULL;
 	struct kdbus_conn_queue *queue;
+	void *stage;
 	u64 msg_size;
 	size_t size;
 	size_t dst_name_len = 0;
@@ -459,9 +550,20 @@ static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
 	if (kmsg->fds && !(conn->flags & KDBUS_HELLO_ACCEPT_FD))
 		return -ECOMM;
 
+	/* point to the payload in the arena, if the receiver has it mapped */
+	if (kmsg->arena_slice && ACCESS_ONCE(conn->arena)) {
+		arena_ref = kmalloc(sizeof(*arena_ref), GFP_KERNEL);
+		if (!arena_ref)
+			return -ENOMEM;
+
+		arena = kmsg->arena_slice;
+	}
+
 	queue = kzalloc(sizeof(struct kdbus_conn_queue), GFP_KERNEL);
-	if (!queue)
+	if (!queue) {
+		kfree(arena_ref);
 		return -ENOMEM;
+	}
 
 	/* copy message properties we need for the queue management */
 	queue->src_id = kmsg->msg.src_id;
@@ -507,57 +609,52 @@ static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
 	vec_data = KDBUS_ALIGN8(msg_size);
 
 	/* allocate the needed space in the pool of the receiver */
-	mutex_lock(&conn->lock);
 	if (conn->disconnected) {
 		ret = -ECONNRESET;
-		goto exit_unlock;
+		goto exit_free;
 	}
 
 	if (conn->msg_count > KDBUS_CONN_MAX_MSGS &&
 	    !kdbus_bus_uid_is_privileged(conn->ep->bus)) {
 		ret = -ENOBUFS;
-		goto exit_unlock;
+		goto exit_free;
 	}
 
 	/* do not give out more than half of the remaining space */
-	want = vec_data + kmsg->vecs_size;
+	want = vec_data;
+	if (!arena)
+		want += kmsg->vecs_size;
 	have = kdbus_pool_remain(conn->pool);
 	if (want < have && want > have / 2) {
 		ret = -EXFULL;
-		goto exit_unlock;
+		goto exit_free;
 	}
 
 	ret = kdbus_pool_alloc_range(conn->pool, want, &off);
 	if (ret < 0)
-		goto exit_unlock;
+		goto exit_free;
 
-	/* copy the message header */
-	ret = kdbus_pool_write(conn->pool, off, &kmsg->msg, size);
-	if (ret < 0)
+	stage = kdbus_conn_stage(conn, msg_size);
+	if (!stage) {
+		ret = -ENOMEM;
 		goto exit_pool_free;
+	}
 
-	/* update the size */
-	ret = kdbus_pool_write(conn->pool, off, &msg_size,
-			       sizeof(kmsg->msg.size));
-	if (ret < 0)
-		goto exit_pool_free;
+	/* copy the message header, and update the size */
+	memcpy(stage, &kmsg->msg, size);
+	((struct kdbus_msg *)stage)->size = msg_size;
 
 	if (dst_name_len  > 0) {
-		char tmp[KDBUS_ITEM_HEADER_SIZE + dst_name_len];
-		struct kdbus_item *it = (struct kdbus_item *)tmp;
+		struct kdbus_item *it = stage + size;
 
 		it->size = KDBUS_ITEM_HEADER_SIZE + dst_name_len;
 		it->type = KDBUS_ITEM_DST_NAME;
 		memcpy(it->str, kmsg->dst_name, dst_name_len);
-
-		ret = kdbus_pool_write(conn->pool, off + size, it, it->size);
-		if (ret < 0)
-			goto exit_pool_free;
 	}
 
 	/* add PAYLOAD items */
 	if (payloads > 0) {
-		ret = kdbus_conn_payload_add(conn, queue, kmsg,
+		ret = kdbus_conn_payload_add(conn, queue, kmsg, arena, stage,
 					     off, payloads, vec_data);
 		if (ret < 0)
 			goto exit_pool_free;
@@ -565,16 +662,11 @@ static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
 
 	/* add a FDS item; the array content will be updated at RECV time */
 	if (kmsg->fds_count > 0) {
-		char tmp[KDBUS_ITEM_HEADER_SIZE];
-		struct kdbus_item *it = (struct kdbus_item *)tmp;
+		struct kdbus_item *it = stage + fds;
 
 		it->type = KDBUS_ITEM_FDS;
 		it->size = KDBUS_ITEM_HEADER_SIZE +
 			   (kmsg->fds_count * sizeof(int));
-		ret = kdbus_pool_write(conn->pool, off + fds,
-				       it, KDBUS_ITEM_HEADER_SIZE);
-		if (ret < 0)
-			goto exit_pool_free;
 
 		ret = kdbus_conn_fds_ref(queue, kmsg->fds, kmsg->fds_count);
 		if (ret < 0)
@@ -586,11 +678,22 @@ static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
 	}
 
 	/* append message metadata/credential items */
-	if (meta > 0) {
-		ret = kdbus_pool_write(conn->pool, off + meta,
-				       kmsg->meta->data, kmsg->meta->size);
-		if (ret < 0)
-			goto exit_pool_free;
+	if (meta > 0)
+		memcpy(stage + meta, kmsg->meta->data, kmsg->meta->size);
+
+	/* copy the header and all items with a single write */
+	ret = kdbus_pool_write(conn->pool, off, stage, msg_size);
+	if (ret < 0)
+		goto exit_pool_free;
+
+	/* keep the arena slice until the receiver frees the message */
+	if (arena) {
+		arena_ref->off = off;
+		arena_ref->slice = kdbus_arena_slice_ref(arena);
+
+		spin_lock(&conn->arena_lock);
+		hash_add(conn->arena_refs, &arena_ref->hentry, off);
+		spin_unlock(&conn->arena_lock);
 	}
 
 	/* copy some properties of the message to the queue entry */
@@ -602,24 +705,40 @@ static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
 	/* link the message into the receiver's queue */
 	kdbus_conn_queue_add(conn, queue);
 
-	mutex_unlock(&conn->lock);
-
 	if (offset)
 		*offset = queue->off;
 
-	/* wake up poll() */
-	wake_up_interruptible(&conn->ep->wait);
 	return 0;
 
 exit_pool_free:
 	kdbus_pool_free_range(conn->pool, off);
 
-exit_unlock:
-	mutex_unlock(&conn->lock);
+exit_free:
 	kdbus_conn_queue_cleanup(queue);
+	kfree(arena_ref);
 	return ret;
 }
 
+/* enqueue a message into the receiver's pool */
+static int kdbus_conn_queue_insert(struct kdbus_conn *conn,
+				   struct kdbus_kmsg *kmsg,
+				   struct kdbus_conn_reply_entry *reply,
+				   u64 *offset)
+{
+	int ret;
+
+	mutex_lock(&conn->lock);
+	ret = kdbus_conn_queue_insert_locked(conn, kmsg, reply, offset);
+	mutex_unlock(&conn->lock);
+
+	if (ret < 0)
+		return ret;
+
+	/* wake up poll() */
+	wake_up_interruptible(&conn->wait);
+	return 0;
+}
+
 static void kdbus_conn_scan_timeout(struct kdbus_conn *conn)
 {
 	struct kdbus_conn_reply_entry *reply, *reply_tmp;
@@ -712,13 +831,7 @@ static int kdbus_conn_get_conn_dst(struct kdbus_bus *bus,
 	int ret = 0;
 
 	if (msg->dst_id == KDBUS_DST_ID_NAME) {
-		const struct kdbus_name_entry *name_entry;
-
 		BUG_ON(!kmsg->dst_name);
-		name_entry = kdbus_name_lookup(bus->name_registry,
-					       kmsg->dst_name);
-		if (!name_entry)
-			return -ESRCH;
 
 		/*
 		 * Record the sequence number of the registered name;
@@ -726,12 +839,11 @@ static int kdbus_conn_get_conn_dst(struct kdbus_bus *bus,
 		 * addressed to a name need to be moved from or to
 		 * activator connections of the same name.
 		 */
-		kmsg->dst_name_id = name_entry->name_id;
-
-		if (!name_entry->conn && name_entry->activator)
-			c = kdbus_conn_ref(name_entry->activator);
-		else
-			c = kdbus_conn_ref(name_entry->conn);
+		ret = kdbus_name_lookup_conn(bus->name_registry,
+					     kmsg->dst_name,
+					     &kmsg->dst_name_id, &c);
+		if (ret < 0)
+			return -ESRCH;
 
 		if ((msg->flags & KDBUS_MSG_FLAGS_NO_AUTO_START) &&
 		    (c->flags & KDBUS_HELLO_ACTIVATOR)) {
@@ -739,10 +851,7 @@ static int kdbus_conn_get_conn_dst(struct kdbus_bus *bus,
 			goto exit_unref;
 		}
 	} else {
-		mutex_lock(&bus->lock);
 		c = kdbus_bus_find_conn_by_id(bus, msg->dst_id);
-		mutex_unlock(&bus->lock);
-
 		if (!c)
 			return -ENXIO;
 
@@ -915,7 +1024,7 @@ static int kdbus_conn_recv_msg(struct kdbus_conn *conn,
 	/* just drop the message */
 	if (recv->flags & KDBUS_RECV_DROP) {
 		kdbus_conn_queue_remove(conn, queue);
-		kdbus_pool_free_range(conn->pool, queue->off);
+		kdbus_conn_free_range(conn, queue->off);
 		kdbus_conn_queue_cleanup(queue);
 		return 0;
 	}
@@ -1011,77 +1120,133 @@ exit_unlock:
 }
 
 /**
- * kdbus_conn_kmsg_send() - send a message
- * @ep:			Endpoint to send from
- * @conn_src:		Connection, kernel-generated messages do not have one
- * @kmsg:		Message to send
+ * kdbus_conn_recv_msg_batch_user - receive multiple messages from the queue
+ * @conn:		Connection to work on
+ * @batch_buf:		A struct kdbus_cmd_recv_batch containing the command
+ *			details
+ *
+ * Messages are de-queued until @count messages are received, the queue is
+ * empty, or no further message matches the requested priority. If an error
+ * occurs after at least one message was received, the call succeeds and
+ * reports the messages received so far. If an offset cannot be written to
+ * the caller's array, -EFAULT is returned, and @count still covers the
+ * offsets written before.
  *
  * Return: 0 on success, negative errno on failure
  */
-int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
-			 struct kdbus_conn *conn_src,
-			 struct kdbus_kmsg *kmsg)
+int kdbus_conn_recv_msg_batch_user(struct kdbus_conn *conn,
+				   struct kdbus_cmd_recv_batch __user *batch_buf)
 {
-	struct kdbus_conn_reply_entry *reply_wait = NULL;
-	struct kdbus_conn_reply_entry *reply_wake = NULL;
-	const struct kdbus_msg *msg = &kmsg->msg;
-	struct kdbus_conn *c, *conn_dst = NULL;
-	u64 offset = ~0ULL;
+	struct kdbus_cmd_recv_batch batch;
+	struct kdbus_cmd_recv recv = {};
+	u64 __user *offsets;
+	u64 count = 0;
 	int ret;
 
-	/* assign namespace-global message sequence number */
-	BUG_ON(kmsg->seq > 0);
-	kmsg->seq = atomic64_inc_return(&ep->bus->ns->msg_seq_last);
+	if (copy_from_user(&batch, batch_buf,
+			   sizeof(struct kdbus_cmd_recv_batch)))
+		return -EFAULT;
 
-	/* non-kernel senders append credentials/metadata */
-	if (conn_src) {
-		ret = kdbus_meta_new(&kmsg->meta);
-		if (ret < 0)
-			return ret;
-	}
+	if (batch.flags & KDBUS_RECV_PEEK)
+		return -EINVAL;
 
-	/* broadcast message */
-	if (msg->dst_id == KDBUS_DST_ID_BROADCAST) {
-		unsigned int i;
+	if (batch.count == 0)
+		return -EINVAL;
 
-		mutex_lock(&ep->bus->lock);
-		hash_for_each(ep->bus->conn_hash, i, conn_dst, hentry) {
-			if (conn_dst->id == msg->src_id)
-				continue;
+	recv.flags = batch.flags;
+	recv.priority = batch.priority;
+	offsets = KDBUS_PTR(batch.offsets);
 
-			/*
-			 * Activator connections will not receive any
-			 * broadcast messages.
-			 */
-			if (conn_dst->flags & KDBUS_HELLO_ACTIVATOR)
-				continue;
+	mutex_lock(&conn->lock);
+	if (unlikely(conn->ep->disconnected)) {
+		ret = -ECONNRESET;
+		goto exit_unlock;
+	}
 
-			if (!kdbus_match_db_match_kmsg(conn_dst->match_db,
-						       conn_src, kmsg))
-				continue;
+	if (conn->msg_count == 0) {
+		ret = -EAGAIN;
+		goto exit_unlock;
+	}
 
-			/*
-			 * The first receiver which requests additional
-			 * metadata causes the message to carry it; all
-			 * receivers after that will see all of the added
-			 * data, even when they did not ask for it.
-			 */
-			if (conn_src)
-				kdbus_meta_append(kmsg->meta, conn_src,
-						  kmsg->seq,
-						  conn_dst->attach_flags);
+	/* fail before anything is de-queued if the count cannot be returned */
+	if (copy_to_user(&batch_buf->count, &count, sizeof(__u64))) {
+		ret = -EFAULT;
+		goto exit_unlock;
+	}
+
+	while (count < batch.count && conn->msg_count > 0) {
+		ret = kdbus_conn_recv_msg(conn, &recv);
+		if (ret < 0)
+			break;
 
-			kdbus_conn_queue_insert(conn_dst, kmsg, NULL, NULL);
+		/*
+		 * Hand out every offset before the next message is
+		 * de-queued, a fault loses at most the current message,
+		 * just like it does for KDBUS_CMD_MSG_RECV. Dropped
+		 * messages do not return an offset.
+		 */
+		if (!(batch.flags & KDBUS_RECV_DROP) &&
+		    copy_to_user(&offsets[count], &recv.offset,
+				 sizeof(__u64))) {
+			ret = -EFAULT;
+			break;
 		}
-		mutex_unlock(&ep->bus->lock);
 
-		return 0;
+		count++;
 	}
 
-	/* direct message */
-	ret = kdbus_conn_get_conn_dst(ep->bus, kmsg, &conn_dst);
-	if (ret < 0)
-		return ret;
+	/*
+	 * The messages received so far are already removed from the queue,
+	 * their offsets must be handed out, regardless of later errors.
+	 */
+	if (count == 0)
+		goto exit_unlock;
+
+	if (ret != -EFAULT)
+		ret = 0;
+
+	/* return the number of de-queued messages */
+	if (copy_to_user(&batch_buf->count, &count, sizeof(__u64)))
+		ret = -EFAULT;
+
+exit_unlock:
+	mutex_unlock(&conn->lock);
+	return ret;
+}
+
+static int kdbus_conn_kmsg_prepare(struct kdbus_ep *ep,
+				   struct kdbus_conn *conn_src,
+				   struct kdbus_kmsg *kmsg)
+{
+	/* assign namespace-global message sequence number */
+	BUG_ON(kmsg->seq > 0);
+	kmsg->seq = atomic64_inc_return(&ep->bus->ns->msg_seq_last);
+
+	/* non-kernel senders append credentials/metadata */
+	if (conn_src)
+		return kdbus_meta_new(&kmsg->meta);
+
+	return 0;
+}
+
+/*
+ * Deliver a direct message to an already pinned destination connection. If
+ * @policy_ok is non-NULL and true, the sender is known to be allowed to
+ * talk to @conn_dst and the policy check is skipped; it is set to true
+ * when the policy check succeeds.
+ */
+static int kdbus_conn_kmsg_send_direct(struct kdbus_ep *ep,
+				       struct kdbus_conn *conn_src,
+				       struct kdbus_conn *conn_dst,
+				       struct kdbus_kmsg *kmsg,
+				       bool *policy_ok)
+{
+	struct kdbus_conn_reply_entry *reply_wait = NULL;
+	struct kdbus_conn_reply_entry *reply_wake = NULL;
+	const struct kdbus_msg *msg = &kmsg->msg;
+	struct kdbus_conn *c;
+	u64 offset = ~0ULL;
+	int ret = 0;
 
 	if (conn_src) {
 		struct kdbus_conn_reply_entry *r;
@@ -1108,12 +1273,16 @@ int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
 		}
 
 		/* ... otherwise, ask the policy DB for permission */
-		if (!reply_wake && ep->policy_db) {
+		if (!reply_wake && ep->policy_db &&
+		    !(policy_ok && *policy_ok)) {
 			ret = kdbus_policy_db_check_send_access(ep->policy_db,
 								conn_src,
 								conn_dst);
 			if (ret < 0)
-				goto exit_unref;
+				goto exit;
+
+			if (policy_ok)
+				*policy_ok = true;
 		}
 	}
 
@@ -1125,13 +1294,13 @@ int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
 		if (atomic_read(&conn_src->reply_count) >
 		    KDBUS_CONN_MAX_REQUESTS_PENDING) {
 			ret = -EMLINK;
-			goto exit_unref;
+			goto exit;
 		}
 
 		reply = kzalloc(sizeof(*reply), GFP_KERNEL);
 		if (!reply) {
 			ret = -ENOMEM;
-			goto exit_unref;
+			goto exit;
 		}
 
 		reply->conn = kdbus_conn_ref(conn_dst);
@@ -1172,7 +1341,7 @@ int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
 		ret = kdbus_meta_append(kmsg->meta, conn_src, kmsg->seq,
 					conn_dst->attach_flags);
 		if (ret < 0)
-			goto exit_unref;
+			goto exit;
 	}
 
 	/*
@@ -1182,7 +1351,7 @@ int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
 	 */
 	ret = kdbus_conn_queue_insert(conn_dst, kmsg, reply_wait, &offset);
 	if (ret < 0)
-		goto exit_unref;
+		goto exit;
 
 	/*
 	 * Monitor connections get all messages; ignore possible errors
@@ -1220,16 +1389,16 @@ int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
 		mutex_unlock(&conn_src->lock);
 
 		if (ret < 0)
-			goto exit_unref;
+			goto exit;
 
 		kmsg->msg.offset_reply = recv.offset;
 
 		ret = kdbus_conn_recv_msg(conn_src, &recv);
 		if (ret < 0)
-			goto exit_unref;
+			goto exit;
 	}
 
-exit_unref:
+exit:
 	/*
 	 * reply_wake is only non-NULL if it refers to a handled reply,
 	 * and kdbus_conn_reply_entry_free() will wake up the wait queue.
@@ -1237,54 +1406,762 @@ exit_unref:
 	if (reply_wake)
 		kdbus_conn_reply_entry_finish(conn_src, reply_wake, offset);
 
-	/* conn_dst got an extra ref from kdbus_conn_get_conn_dst */
-	kdbus_conn_unref(conn_dst);
-
 	return ret;
 }
 
 /**
- * kdbus_conn_kmsg_free() - free a list of kmsg objects
- * @kmsg_list:		List head of kmsg objects to free.
+ * struct kdbus_conn_fanout - a broadcast delivered by several workers
+ * @kmsg:		The message to deliver
+ * @cred:		Credentials of the sending task, the workers act with
+ *			them to apply the same limits as the sender
+ * @conns:		The receivers of the message
+ * @count:		Number of receivers
+ * @next:		Index of the next chunk of receivers to deliver to
+ * @pending:		Number of workers which have not finished yet
+ * @done:		Completed by the last worker
  */
-void kdbus_conn_kmsg_list_free(struct list_head *kmsg_list)
-{
-	struct kdbus_kmsg *kmsg, *tmp;
-
-	list_for_each_entry_safe(kmsg, tmp, kmsg_list, queue_entry) {
-		list_del(&kmsg->queue_entry);
-		kdbus_kmsg_free(kmsg);
-	}
-}
+struct kdbus_conn_fanout {
+	struct kdbus_kmsg *kmsg;
+	const struct cred *cred;
+	struct kdbus_conn **conns;
+	unsigned int count;
+	atomic_t next;
+	atomic_t pending;
+	struct completion done;
+};
 
 /**
- * kdbus_conn_kmsg_list_send() - send a list of previously collected messages
- * @ep:			The endpoint to use for sending
- * @kmsg_list:		List head of kmsg objects to send.
- *
- * The list is cleared and freed after sending.
- *
- * Return: 0 on success, negative errno on failure
+ * struct kdbus_conn_fanout_work - a worker of a parallel broadcast
+ * @work:		The work item, queued on an unbound workqueue
+ * @fanout:		The broadcast to deliver
  */
-int kdbus_conn_kmsg_list_send(struct kdbus_ep *ep,
-			      struct list_head *kmsg_list)
+struct kdbus_conn_fanout_work {
+	struct work_struct work;
+	struct kdbus_conn_fanout *fanout;
+};
+
+/*
+ * Deliver chunks of receivers until none are left. Every worker takes the
+ * next chunk when it is done with its previous one, so the workers which
+ * get to run early take over the share of the ones which start late.
+ */
+static void kdbus_conn_fanout_run(struct kdbus_conn_fanout *fanout)
 {
-	struct kdbus_kmsg *kmsg;
-	int ret = 0;
+	for (;;) {
+		unsigned int start, end, i;
 
-	list_for_each_entry(kmsg, kmsg_list, queue_entry) {
-		ret = kdbus_conn_kmsg_send(ep, NULL, kmsg);
-		if (ret < 0)
+		start = (atomic_inc_return(&fanout->next) - 1) *
+			KDBUS_CONN_FANOUT_CHUNK;
+		if (start >= fanout->count)
 			break;
+
+		end = min(start + KDBUS_CONN_FANOUT_CHUNK, fanout->count);
+		for (i = start; i < end; i++)
+			kdbus_conn_queue_insert(fanout->conns[i],
+						fanout->kmsg, NULL, NULL);
 	}
+}
 
-	kdbus_conn_kmsg_list_free(kmsg_list);
+static void kdbus_conn_fanout_work(struct work_struct *work)
+{
+	struct kdbus_conn_fanout_work *w =
+		container_of(work, struct kdbus_conn_fanout_work, work);
+	struct kdbus_conn_fanout *fanout = w->fanout;
+	const struct cred *cred;
 
-	return ret;
+	cred = override_creds(fanout->cred);
+	kdbus_conn_fanout_run(fanout);
+	revert_creds(cred);
+
+	if (atomic_dec_and_test(&fanout->pending))
+		complete(&fanout->done);
 }
 
-/**
- * kdbus_conn_disconnect() - disconnect a connection
+/*
+ * Deliver a broadcast to a large list of receivers on several CPUs. The
+ * sending task works on the delivery itself, and waits for the workers to
+ * finish; the caller holds the bus lock for the whole time, so broadcasts
+ * still reach every receiver in the order of their sequence numbers.
+ *
+ * Return: false if the delivery was not done, and is left to the caller.
+ */
+static bool kdbus_conn_fanout(struct kdbus_kmsg *kmsg,
+			      struct list_head *list, unsigned int count)
+{
+	unsigned int batch = ACCESS_ONCE(kdbus_conn_broadcast_batch);
+	struct kdbus_conn_fanout_work *works;
+	struct kdbus_conn_fanout fanout;
+	struct kdbus_conn *conn, *tmp;
+	unsigned int n_works, i;
+
+	if (batch == 0)
+		return false;
+
+	n_works = min(num_online_cpus(), count / batch);
+	if (n_works < 2)
+		return false;
+
+	fanout.conns = kmalloc_array(count, sizeof(struct kdbus_conn *),
+				     GFP_KERNEL);
+	if (!fanout.conns)
+		return false;
+
+	/* the sending task is one of the workers */
+	works = kcalloc(n_works - 1, sizeof(*works), GFP_KERNEL);
+	if (!works) {
+		kfree(fanout.conns);
+		return false;
+	}
+
+	i = 0;
+	list_for_each_entry_safe(conn, tmp, list, match_entry) {
+		list_del(&conn->match_entry);
+		fanout.conns[i++] = conn;
+	}
+
+	fanout.kmsg = kmsg;
+	fanout.cred = current_cred();
+	fanout.count = count;
+	atomic_set(&fanout.next, 0);
+	atomic_set(&fanout.pending, n_works - 1);
+	init_completion(&fanout.done);
+
+	for (i = 0; i < n_works - 1; i++) {
+		INIT_WORK(&works[i].work, kdbus_conn_fanout_work);
+		works[i].fanout = &fanout;
+		queue_work(system_unbound_wq, &works[i].work);
+	}
+
+	kdbus_conn_fanout_run(&fanout);
+	wait_for_completion(&fanout.done);
+
+	kfree(works);
+	kfree(fanout.conns);
+	return true;
+}
+
+/*
+ * Deliver a broadcast to all connections with a matching subscription. The
+ * caller must hold the bus lock.
+ */
+static void kdbus_conn_broadcast(struct kdbus_ep *ep,
+				 struct kdbus_conn *conn_src,
+				 struct kdbus_kmsg *kmsg)
+{
+	struct kdbus_conn *conn_dst, *tmp;
+	unsigned int count = 0;
+	u64 attach_flags = 0;
+	LIST_HEAD(candidates);
+	LIST_HEAD(list);
+
+	kdbus_match_index_candidates(ep->bus->match_index,
+				     conn_src, kmsg, &candidates);
+	list_for_each_entry_safe(conn_dst, tmp, &candidates, match_entry) {
+		list_del(&conn_dst->match_entry);
+
+		if (conn_dst->id == kmsg->msg.src_id)
+			continue;
+
+		/*
+		 * Activator connections will not receive any
+		 * broadcast messages.
+		 */
+		if (conn_dst->flags & KDBUS_HELLO_ACTIVATOR)
+			continue;
+
+		if (!kdbus_match_db_match_kmsg(conn_dst->match_db,
+					       conn_src, kmsg))
+			continue;
+
+		list_add_tail(&conn_dst->match_entry, &list);
+		attach_flags |= conn_dst->attach_flags;
+		count++;
+	}
+
+	/*
+	 * The message carries the metadata any of the receivers asks for;
+	 * all receivers will see all of the added data, even when they did
+	 * not ask for it.
+	 */
+	if (conn_src && count > 0)
+		kdbus_meta_append(kmsg->meta, conn_src, kmsg->seq,
+				  attach_flags);
+
+	if (kdbus_conn_fanout(kmsg, &list, count))
+		return;
+
+	list_for_each_entry_safe(conn_dst, tmp, &list, match_entry) {
+		list_del(&conn_dst->match_entry);
+		kdbus_conn_queue_insert(conn_dst, kmsg, NULL, NULL);
+	}
+}
+
+/**
+ * kdbus_conn_kmsg_send() - send a message
+ * @ep:			Endpoint to send from
+ * @conn_src:		Connection, kernel-generated messages do not have one
+ * @kmsg:		Message to send
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
+			 struct kdbus_conn *conn_src,
+			 struct kdbus_kmsg *kmsg)
+{
+	const struct kdbus_msg *msg = &kmsg->msg;
+	struct kdbus_conn *conn_dst = NULL;
+	int ret;
+
+	ret = kdbus_conn_kmsg_prepare(ep, conn_src, kmsg);
+	if (ret < 0)
+		return ret;
+
+	/* broadcast message */
+	if (msg->dst_id == KDBUS_DST_ID_BROADCAST) {
+		/*
+		 * Copy the payload from the sender only once, outside of the
+		 * bus lock; all receivers copy it from the kernel buffer.
+		 */
+		ret = kdbus_kmsg_vecs_stage(kmsg);
+		if (ret < 0)
+			return ret;
+
+		/*
+		 * Store large payloads once in the bus's arena, for the
+		 * receivers which have it mapped. If it does not fit, all
+		 * receivers get a copy in their pool. Without any receiver
+		 * using the arena, the copy into it would only be wasted.
+		 */
+		if (ep->bus->arena && kmsg->vecs_size >= KDBUS_ARENA_MIN_SIZE &&
+		    atomic_read(&ep->bus->arena_users) > 0)
+			kdbus_arena_slice_new(ep->bus->arena, kmsg->vecs,
+					      kmsg->vecs_size,
+					      &kmsg->arena_slice);
+
+		mutex_lock(&ep->bus->lock);
+		kdbus_conn_broadcast(ep, conn_src, kmsg);
+		mutex_unlock(&ep->bus->lock);
+
+		return 0;
+	}
+
+	/* direct message */
+	ret = kdbus_conn_get_conn_dst(ep->bus, kmsg, &conn_dst);
+	if (ret < 0)
+		return ret;
+
+	ret = kdbus_conn_kmsg_send_direct(ep, conn_src, conn_dst, kmsg, NULL);
+
+	/* conn_dst got an extra ref from kdbus_conn_get_conn_dst */
+	kdbus_conn_unref(conn_dst);
+
+	return ret;
+}
+
+/*
+ * Send one message of a batch. @conn_dst caches the destination of the
+ * previous message; consecutive messages to the same unique ID skip the
+ * lookup in the bus, and messages to the same destination connection skip
+ * the policy check once it has succeeded.
+ */
+static int kdbus_conn_kmsg_send_batch_one(struct kdbus_conn *conn_src,
+					  struct kdbus_msg __user *msg_user,
+					  struct kdbus_conn **conn_dst,
+					  bool *policy_ok)
+{
+	struct kdbus_ep *ep = conn_src->ep;
+	struct kdbus_kmsg *kmsg = NULL;
+	const struct kdbus_msg *msg;
+	struct kdbus_conn *c;
+	int ret;
+
+	/* every message must be aligned, like for KDBUS_CMD_MSG_SEND */
+	if (!KDBUS_IS_ALIGNED8((uintptr_t)msg_user))
+		return -EFAULT;
+
+	ret = kdbus_kmsg_new_from_user(conn_src, msg_user, &kmsg);
+	if (ret < 0)
+		return ret;
+
+	msg = &kmsg->msg;
+
+	/* a batch cannot block while waiting for a reply */
+	if (msg->flags & KDBUS_MSG_FLAGS_SYNC_REPLY) {
+		ret = -EINVAL;
+		goto exit_free;
+	}
+
+	if (msg->dst_id == KDBUS_DST_ID_BROADCAST) {
+		ret = kdbus_conn_kmsg_send(ep, conn_src, kmsg);
+		goto exit_free;
+	}
+
+	/*
+	 * Unique IDs are never re-used, so a cached connection with the same
+	 * ID is still the right one. Well-known names can change their owner
+	 * at any time and are always looked up again.
+	 */
+	if (msg->dst_id == KDBUS_DST_ID_NAME ||
+	    !*conn_dst || (*conn_dst)->id != msg->dst_id) {
+		ret = kdbus_conn_get_conn_dst(ep->bus, kmsg, &c);
+		if (ret < 0)
+			goto exit_free;
+
+		if (c != *conn_dst) {
+			kdbus_conn_unref(*conn_dst);
+			*conn_dst = c;
+			*policy_ok = false;
+		} else {
+			kdbus_conn_unref(c);
+		}
+	} else if ((*conn_dst)->flags &
+		   (KDBUS_HELLO_ACTIVATOR|KDBUS_HELLO_MONITOR)) {
+		/*
+		 * The cached connection might have been resolved by name;
+		 * special-purpose connections are not allowed to be addressed
+		 * via their unique IDs.
+		 */
+		ret = -ENXIO;
+		goto exit_free;
+	} else if (!kdbus_conn_active(*conn_dst)) {
+		ret = -ECONNRESET;
+		goto exit_free;
+	}
+
+	ret = kdbus_conn_kmsg_prepare(ep, conn_src, kmsg);
+	if (ret < 0)
+		goto exit_free;
+
+	ret = kdbus_conn_kmsg_send_direct(ep, conn_src, *conn_dst,
+					  kmsg, policy_ok);
+
+exit_free:
+	kdbus_kmsg_free(kmsg);
+	return ret;
+}
+
+/**
+ * kdbus_conn_kmsg_send_batch_user() - send multiple messages
+ * @conn:		Connection to send from
+ * @batch_buf:		A struct kdbus_cmd_send_batch containing the command
+ *			details
+ *
+ * Every message is sent independently of the others; the result of each
+ * message is stored in the user-supplied results array.
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_conn_kmsg_send_batch_user(struct kdbus_conn *conn,
+				    struct kdbus_cmd_send_batch __user *batch_buf)
+{
+	struct kdbus_cmd_send_batch batch;
+	struct kdbus_conn *conn_dst = NULL;
+	bool policy_ok = false;
+	s64 *results = NULL;
+	u64 *msgs = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	if (copy_from_user(&batch, batch_buf,
+			   sizeof(struct kdbus_cmd_send_batch)))
+		return -EFAULT;
+
+	if (batch.flags != 0 || batch.count == 0)
+		return -EINVAL;
+
+	if (batch.count > KDBUS_MSG_MAX_BATCH)
+		return -E2BIG;
+
+	msgs = kmalloc(batch.count * sizeof(u64), GFP_KERNEL);
+	if (!msgs)
+		return -ENOMEM;
+
+	results = kmalloc(batch.count * sizeof(s64), GFP_KERNEL);
+	if (!results) {
+		ret = -ENOMEM;
+		goto exit_free;
+	}
+
+	if (copy_from_user(msgs, KDBUS_PTR(batch.msgs),
+			   batch.count * sizeof(u64))) {
+		ret = -EFAULT;
+		goto exit_free;
+	}
+
+	for (i = 0; i < batch.count; i++)
+		results[i] = kdbus_conn_kmsg_send_batch_one(conn,
+							    KDBUS_PTR(msgs[i]),
+							    &conn_dst,
+							    &policy_ok);
+
+	kdbus_conn_unref(conn_dst);
+
+	if (copy_to_user(KDBUS_PTR(batch.results), results,
+			 batch.count * sizeof(s64)))
+		ret = -EFAULT;
+
+exit_free:
+	kfree(results);
+	kfree(msgs);
+	return ret;
+}
+
+/**
+ * kdbus_conn_ring_setup_user() - create the rings of a connection
+ * @conn:		Connection
+ * @buf:		A struct kdbus_cmd_ring containing the command details
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_conn_ring_setup_user(struct kdbus_conn *conn,
+			       struct kdbus_cmd_ring __user *buf)
+{
+	struct kdbus_ring *ring;
+	struct kdbus_cmd_ring cmd;
+	int ret;
+
+	if (copy_from_user(&cmd, buf, sizeof(struct kdbus_cmd_ring)))
+		return -EFAULT;
+
+	if (cmd.flags != 0 || cmd.entries > KDBUS_RING_MAX_ENTRIES)
+		return -EINVAL;
+
+	ret = kdbus_ring_new(cmd.entries, &ring);
+	if (ret < 0)
+		return ret;
+
+	/* the rings are mapped right behind the pool */
+	kdbus_ring_layout(ring, &cmd);
+	cmd.offset = kdbus_pool_size(conn->pool);
+
+	if (copy_to_user(buf, &cmd, sizeof(struct kdbus_cmd_ring))) {
+		ret = -EFAULT;
+		goto exit_free;
+	}
+
+	mutex_lock(&conn->lock);
+	if (conn->ring) {
+		mutex_unlock(&conn->lock);
+		ret = -EEXIST;
+		goto exit_free;
+	}
+
+	/* poll() and mmap() look at the ring without conn->lock */
+	smp_wmb();
+	conn->ring = ring;
+	mutex_unlock(&conn->lock);
+
+	return 0;
+
+exit_free:
+	kdbus_ring_free(ring);
+	return ret;
+}
+
+static int kdbus_conn_ring_op(struct kdbus_conn *conn,
+			      const struct kdbus_ring_sqe *sqe,
+			      u64 *offset)
+{
+	struct kdbus_cmd_recv recv = {};
+	struct kdbus_kmsg *kmsg = NULL;
+	int ret;
+
+	switch (sqe->op) {
+	case KDBUS_RING_OP_SEND:
+		ret = kdbus_kmsg_new_from_user(conn, KDBUS_PTR(sqe->arg),
+					       &kmsg);
+		if (ret < 0)
+			return ret;
+
+		/* the ring cannot block while waiting for a reply */
+		if (kmsg->msg.flags & KDBUS_MSG_FLAGS_SYNC_REPLY)
+			ret = -EINVAL;
+		else
+			ret = kdbus_conn_kmsg_send(conn->ep, conn, kmsg);
+
+		kdbus_kmsg_free(kmsg);
+		return ret;
+
+	case KDBUS_RING_OP_RECV:
+		if (sqe->flags & KDBUS_RECV_PEEK)
+			return -EINVAL;
+
+		recv.flags = sqe->flags;
+		recv.priority = (s64) sqe->arg;
+
+		mutex_lock(&conn->lock);
+		if (unlikely(conn->ep->disconnected))
+			ret = -ECONNRESET;
+		else if (conn->msg_count == 0)
+			ret = -EAGAIN;
+		else
+			ret = kdbus_conn_recv_msg(conn, &recv);
+		mutex_unlock(&conn->lock);
+
+		if (ret == 0 && !(sqe->flags & KDBUS_RECV_DROP))
+			*offset = recv.offset;
+
+		return ret;
+
+	case KDBUS_RING_OP_FREE:
+		return kdbus_conn_free_range(conn, sqe->arg);
+	}
+
+	return -EOPNOTSUPP;
+}
+
+/**
+ * kdbus_conn_arena_setup_user() - receive broadcast payloads in the arena
+ * @conn:		Connection
+ * @buf:		A struct kdbus_cmd_arena containing the command details
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_conn_arena_setup_user(struct kdbus_conn *conn,
+				struct kdbus_cmd_arena __user *buf)
+{
+	struct kdbus_arena *arena = conn->ep->bus->arena;
+	struct kdbus_cmd_arena cmd;
+
+	if (copy_from_user(&cmd, buf, sizeof(struct kdbus_cmd_arena)))
+		return -EFAULT;
+
+	if (cmd.flags != 0)
+		return -EINVAL;
+
+	if (!arena)
+		return -EOPNOTSUPP;
+
+	/* the arena is mapped behind the pool, leaving room for the rings */
+	cmd.offset = kdbus_pool_size(conn->pool) + KDBUS_ARENA_MAP_GAP;
+	cmd.size = kdbus_arena_size(arena);
+
+	if (copy_to_user(buf, &cmd, sizeof(struct kdbus_cmd_arena)))
+		return -EFAULT;
+
+	mutex_lock(&conn->lock);
+	if (conn->disconnected) {
+		mutex_unlock(&conn->lock);
+		return -ECONNRESET;
+	}
+
+	/* message delivery and mmap() look at the arena without conn->lock */
+	if (!conn->arena) {
+		ACCESS_ONCE(conn->arena) = arena;
+		atomic_inc(&conn->ep->bus->arena_users);
+	}
+	mutex_unlock(&conn->lock);
+
+	return 0;
+}
+
+/**
+ * kdbus_conn_free_range() - free a message or reply in the pool
+ * @conn:		Connection
+ * @off:		Offset of the allocated memory in the pool
+ *
+ * Like kdbus_pool_free_range(), but also releases the arena slice the
+ * message may point to.
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_conn_free_range(struct kdbus_conn *conn, size_t off)
+{
+	struct kdbus_conn_arena_ref *ref = NULL, *r;
+	int ret;
+
+	if (ACCESS_ONCE(conn->arena)) {
+		spin_lock(&conn->arena_lock);
+		hash_for_each_possible(conn->arena_refs, r, hentry, off) {
+			if (r->off != off)
+				continue;
+
+			hash_del(&r->hentry);
+			ref = r;
+			break;
+		}
+		spin_unlock(&conn->arena_lock);
+	}
+
+	/*
+	 * The reference is looked up before the memory is freed; after that,
+	 * a new message can be stored at the same offset.
+	 */
+	ret = kdbus_pool_free_range(conn->pool, off);
+
+	if (ref) {
+		kdbus_arena_slice_unref(ref->slice);
+		kfree(ref);
+	}
+
+	return ret;
+}
+
+/**
+ * kdbus_conn_ring_enter() - process the submission ring of a connection
+ * @conn:		Connection
+ *
+ * All pending entries of the submission ring are processed, as long as
+ * there is room in the completion ring to post their results. The
+ * operations run in the context of the calling task, which reads the
+ * messages to send, and receives the file descriptors of received ones.
+ *
+ * Return: the number of processed entries, negative errno on failure
+ */
+int kdbus_conn_ring_enter(struct kdbus_conn *conn)
+{
+	struct kdbus_ring *ring = ACCESS_ONCE(conn->ring);
+	struct kdbus_ring_sqe sqe;
+	int count = 0;
+
+	if (!ring)
+		return -ENXIO;
+
+	smp_rmb();
+
+	mutex_lock(&ring->lock);
+
+	while (kdbus_ring_sqe_get(ring, &sqe)) {
+		u64 offset = ~0ULL;
+		int ret;
+
+		ret = kdbus_conn_ring_op(conn, &sqe, &offset);
+		kdbus_ring_cqe_post(ring, sqe.user_data, ret, offset);
+		count++;
+	}
+
+	mutex_unlock(&ring->lock);
+
+	/* wake up poll() waiting for completions */
+	if (count > 0)
+		wake_up_interruptible(&conn->wait);
+
+	return count;
+}
+
+/**
+ * kdbus_conn_kmsg_free() - free a list of kmsg objects
+ * @kmsg_list:		List head of kmsg objects to free.
+ */
+void kdbus_conn_kmsg_list_free(struct list_head *kmsg_list)
+{
+	struct kdbus_kmsg *kmsg, *tmp;
+
+	list_for_each_entry_safe(kmsg, tmp, kmsg_list, queue_entry) {
+		list_del(&kmsg->queue_entry);
+		kdbus_kmsg_free(kmsg);
+	}
+}
+
+/*
+ * Deliver a list of broadcast kernel notifications. Every receiver is
+ * matched against all notifications in one pass, and gets all of its
+ * notifications queued under one acquisition of its lock and with a single
+ * wakeup. The caller must hold the bus lock.
+ */
+static void kdbus_conn_broadcast_list(struct kdbus_ep *ep,
+				      struct list_head *kmsg_list)
+{
+	struct kdbus_conn *conn_dst, *tmp;
+	struct kdbus_kmsg *kmsg;
+	LIST_HEAD(candidates);
+
+	kdbus_match_index_candidates_notify(ep->bus->match_index,
+					    kmsg_list, &candidates);
+	list_for_each_entry_safe(conn_dst, tmp, &candidates, match_entry) {
+		unsigned int count = 0;
+
+		list_del(&conn_dst->match_entry);
+
+		/*
+		 * Activator connections will not receive any
+		 * broadcast messages.
+		 */
+		if (conn_dst->flags & KDBUS_HELLO_ACTIVATOR)
+			continue;
+
+		mutex_lock(&conn_dst->lock);
+		list_for_each_entry(kmsg, kmsg_list, queue_entry) {
+			if (!kdbus_match_db_match_kmsg(conn_dst->match_db,
+						       NULL, kmsg))
+				continue;
+
+			if (kdbus_conn_queue_insert_locked(conn_dst, kmsg,
+							   NULL, NULL) == 0)
+				count++;
+		}
+		mutex_unlock(&conn_dst->lock);
+
+		if (count > 0)
+			wake_up_interruptible(&conn_dst->wait);
+	}
+}
+
+/* deliver and free a run of consecutive broadcasts of a message list */
+static void kdbus_conn_broadcast_run(struct kdbus_ep *ep,
+				     struct list_head *run)
+{
+	struct kdbus_kmsg *kmsg;
+
+	if (list_empty(run))
+		return;
+
+	list_for_each_entry(kmsg, run, queue_entry)
+		kdbus_conn_kmsg_prepare(ep, NULL, kmsg);
+
+	mutex_lock(&ep->bus->lock);
+	kdbus_conn_broadcast_list(ep, run);
+	mutex_unlock(&ep->bus->lock);
+
+	kdbus_conn_kmsg_list_free(run);
+}
+
+/**
+ * kdbus_conn_kmsg_list_send() - send a list of previously collected messages
+ * @ep:			The endpoint to use for sending
+ * @kmsg_list:		List head of kmsg objects to send.
+ *
+ * Messages are delivered in the order of the list. Messages to a specific
+ * connection are sent one by one; every run of consecutive broadcast
+ * messages is delivered as one batch under a single acquisition of the bus
+ * lock. A failure to deliver one message does not stop the delivery of the
+ * others.
+ *
+ * The list is cleared and freed after sending.
+ *
+ * Return: 0 on success, the first error of a failed message otherwise
+ */
+int kdbus_conn_kmsg_list_send(struct kdbus_ep *ep,
+			      struct list_head *kmsg_list)
+{
+	struct kdbus_kmsg *kmsg, *tmp;
+	LIST_HEAD(broadcasts);
+	int ret = 0;
+
+	list_for_each_entry_safe(kmsg, tmp, kmsg_list, queue_entry) {
+		int r;
+
+		if (kmsg->msg.dst_id == KDBUS_DST_ID_BROADCAST) {
+			list_move_tail(&kmsg->queue_entry, &broadcasts);
+			continue;
+		}
+
+		/* the broadcasts collected so far go out first */
+		kdbus_conn_broadcast_run(ep, &broadcasts);
+
+		r = kdbus_conn_kmsg_send(ep, NULL, kmsg);
+		if (r < 0 && ret == 0)
+			ret = r;
+	}
+
+	kdbus_conn_broadcast_run(ep, &broadcasts);
+	kdbus_conn_kmsg_list_free(kmsg_list);
+
+	return ret;
+}
+
+/**
+ * kdbus_conn_disconnect() - disconnect a connection
  * @conn:			The connection to disconnect
  * @ensure_msg_list_empty:	Flag to indicate if the call should fail in
  *				case the connection's message list is not
@@ -1313,14 +2190,20 @@ int kdbus_conn_disconnect(struct kdbus_conn *conn, bool ensure_msg_list_empty)
 	}
 
 	conn->disconnected = true;
+	if (conn->arena)
+		atomic_dec(&conn->ep->bus->arena_users);
 	mutex_unlock(&conn->lock);
 
+	/* let pending poll() calls notice the disconnect */
+	wake_up_interruptible(&conn->wait);
+
 	bus = conn->ep->bus;
 
 	/* remove from bus */
 	mutex_lock(&bus->lock);
-	hash_del(&conn->hentry);
+	kdbus_bus_conn_del(bus, conn);
 	list_del(&conn->monitor_entry);
+	kdbus_match_db_unindex(conn->match_db, bus->match_index);
 	mutex_unlock(&bus->lock);
 
 	/* clean up any messages still left on this endpoint */
@@ -1331,7 +2214,7 @@ int kdbus_conn_disconnect(struct kdbus_conn *conn, bool ensure_msg_list_empty)
 						queue->cookie, &notify_list);
 
 		list_del(&queue->entry);
-		kdbus_pool_free_range(conn->pool, queue->off);
+		kdbus_conn_free_range(conn, queue->off);
 		kdbus_conn_queue_cleanup(queue);
 	}
 	mutex_unlock(&conn->lock);
@@ -1339,11 +2222,10 @@ int kdbus_conn_disconnect(struct kdbus_conn *conn, bool ensure_msg_list_empty)
 	/* if we die while other connections wait for our reply, notify them */
 	if (unlikely(atomic_read(&conn->reply_count) > 0)) {
 		struct kdbus_conn *c;
-		int i;
 		struct kdbus_conn_reply_entry *reply, *reply_tmp;
 
 		mutex_lock(&bus->lock);
-		hash_for_each(bus->conn_hash, i, c, hentry) {
+		list_for_each_entry(c, &bus->conn_list, bus_entry) {
 
 			mutex_lock(&c->lock);
 			list_for_each_entry_safe(reply, reply_tmp,
@@ -1391,6 +2273,20 @@ bool kdbus_conn_active(struct kdbus_conn *conn)
 	return active;
 }
 
+/* release the arena slices of all messages left in the pool */
+static void kdbus_conn_arena_refs_free(struct kdbus_conn *conn)
+{
+	struct kdbus_conn_arena_ref *ref;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	hash_for_each_safe(conn->arena_refs, i, tmp, ref, hentry) {
+		hash_del(&ref->hentry);
+		kdbus_arena_slice_unref(ref->slice);
+		kfree(ref);
+	}
+}
+
 static void __kdbus_conn_free(struct kref *kref)
 {
 	struct kdbus_conn *conn = container_of(kref, struct kdbus_conn, kref);
@@ -1409,11 +2305,14 @@ static void __kdbus_conn_free(struct kref *kref)
 
 	kdbus_meta_free(conn->owner_meta);
 	kdbus_match_db_free(conn->match_db);
+	kdbus_ring_free(conn->ring);
+	kdbus_conn_arena_refs_free(conn);
 	kdbus_pool_free(conn->pool);
+	kfree(conn->stage);
 	kdbus_ep_unref(conn->ep);
 	security_kdbus_free(conn);
 	kfree(conn->name);
-	kfree(conn);
+	kfree_rcu(conn, rcu);
 }
 
 /**
@@ -1428,6 +2327,24 @@ struct kdbus_conn *kdbus_conn_ref(struct kdbus_conn *conn)
 	return conn;
 }
 
+/**
+ * kdbus_conn_ref_rcu() - take a reference of a connection found under RCU
+ * @conn:		Connection, found under rcu_read_lock()
+ *
+ * Connections are freed with RCU, so a connection found in an RCU-protected
+ * structure stays valid until rcu_read_unlock(), but its last reference
+ * may already be gone.
+ *
+ * Return: the connection itself, or NULL if it is being freed
+ */
+struct kdbus_conn *kdbus_conn_ref_rcu(struct kdbus_conn *conn)
+{
+	if (!kref_get_unless_zero(&conn->kref))
+		return NULL;
+
+	return conn;
+}
+
 /**
  * kdbus_conn_unref() - drop a connection reference
  * @conn:		Connection (may be NULL)
@@ -1503,7 +2420,7 @@ int kdbus_conn_move_messages(struct kdbus_conn *conn_dst,
 exit_unlock_dst:
 	mutex_unlock(&conn_dst->lock);
 
-	wake_up_interruptible(&conn_dst->ep->wait);
+	wake_up_interruptible(&conn_dst->wait);
 
 	return ret;
 }
@@ -1555,11 +2472,8 @@ int kdbus_cmd_conn_info(struct kdbus_conn *conn,
 		name = cmd_info->name;
 		hash = kdbus_str_hash(name);
 	} else {
-		struct kdbus_bus *bus = conn->ep->bus;
-
-		mutex_lock(&bus->lock);
-		owner_conn = kdbus_bus_find_conn_by_id(bus, cmd_info->id);
-		mutex_unlock(&bus->lock);
+		owner_conn = kdbus_bus_find_conn_by_id(conn->ep->bus,
+						       cmd_info->id);
 	}
 
 	/*
@@ -1568,21 +2482,17 @@ int kdbus_cmd_conn_info(struct kdbus_conn *conn,
 	 * was already set above.
 	 */
 	if (name) {
-		struct kdbus_name_entry *e;
-
 		if (!kdbus_check_strlen(cmd_info, name)) {
 			ret = -EINVAL;
 			goto exit;
 		}
 
-		e = kdbus_name_lookup(conn->ep->bus->name_registry, name);
-		if (!e) {
+		ret = kdbus_name_lookup_conn(conn->ep->bus->name_registry,
+					     name, NULL, &owner_conn);
+		if (ret == -ESRCH) {
 			ret = -ENOENT;
 			goto exit;
 		}
-
-		if (e->conn)
-			owner_conn = kdbus_conn_ref(e->conn);
 	}
 
 	if (!owner_conn) {
@@ -1682,6 +2592,7 @@ int kdbus_conn_new(struct kdbus_ep *ep,
 	const struct kdbus_creds *creds = NULL;
 	const char *seclabel = NULL;
 	size_t seclabel_len = 0;
+	unsigned int pool_flags = 0;
 	LIST_HEAD(notify_list);
 	int ret;
 
@@ -1698,6 +2609,16 @@ int kdbus_conn_new(struct kdbus_ep *ep,
 		!kdbus_bus_uid_is_privileged(bus))
 		return -EPERM;
 
+	/* a mapped pool pins all of its memory, like mlock() */
+	if (hello->conn_flags & KDBUS_HELLO_POOL_MAPPED) {
+		if (!kdbus_bus_uid_is_privileged(bus) &&
+		    !capable(CAP_IPC_LOCK))
+			return -EPERM;
+
+		if (hello->pool_size > KDBUS_POOL_MAPPED_MAX_SIZE)
+			return -EMSGSIZE;
+	}
+
 	KDBUS_ITEM_FOREACH(item, hello, items) {
 		switch (item->type) {
 		case KDBUS_ITEM_NAME:
@@ -1786,9 +2707,13 @@ int kdbus_conn_new(struct kdbus_ep *ep,
 	mutex_init(&conn->lock);
 	INIT_LIST_HEAD(&conn->msg_list);
 	conn->msg_prio_queue = RB_ROOT;
+	init_waitqueue_head(&conn->wait);
 	INIT_LIST_HEAD(&conn->names_list);
 	INIT_LIST_HEAD(&conn->names_queue_list);
 	INIT_LIST_HEAD(&conn->reply_list);
+	INIT_LIST_HEAD(&conn->match_entry);
+	spin_lock_init(&conn->arena_lock);
+	hash_init(conn->arena_refs);
 	atomic_set(&conn->reply_count, 0);
 	INIT_WORK(&conn->work, kdbus_conn_work);
 	init_timer(&conn->timer);
@@ -1798,9 +2723,16 @@ int kdbus_conn_new(struct kdbus_ep *ep,
 	add_timer(&conn->timer);
 
 	/* init entry, so we can unconditionally remove it */
+	INIT_LIST_HEAD(&conn->bus_entry);
 	INIT_LIST_HEAD(&conn->monitor_entry);
 
-	ret = kdbus_pool_new(conn->name, hello->pool_size, &conn->pool);
+	if (hello->conn_flags & KDBUS_HELLO_POOL_FIFO)
+		pool_flags |= KDBUS_POOL_FIFO;
+	if (hello->conn_flags & KDBUS_HELLO_POOL_MAPPED)
+		pool_flags |= KDBUS_POOL_MAPPED;
+
+	ret = kdbus_pool_new(conn->name, hello->pool_size, pool_flags,
+			     &conn->pool);
 	if (ret < 0)
 		goto exit_free_conn;
 
@@ -1895,7 +2827,7 @@ int kdbus_conn_new(struct kdbus_ep *ep,
 
 	/* link into bus */
 	mutex_lock(&bus->lock);
-	hash_add(bus->conn_hash, &conn->hentry, conn->id);
+	kdbus_bus_conn_add(bus, conn);
 	mutex_unlock(&bus->lock);
 
 	*c = conn;
@@ -1921,27 +2853,3 @@ exit_free_conn:
 
 	return ret;
 }
-
-/**
- * kdbus_conn_has_name() - check if a connection owns a name
- * @conn:		Connection
- * @name:		Well-know name to check for
- *
- * Return: true if the name is currently owned by the connection
- */
-bool kdbus_conn_has_name(struct kdbus_conn *conn, const char *name)
-{
-	struct kdbus_name_entry *e;
-	bool match = false;
-
-	mutex_lock(&conn->lock);
-	list_for_each_entry(e, &conn->names_list, conn_entry) {
-		if (strcmp(e->name, name) == 0) {
-			match = true;
-			break;
-		}
-	}
-	mutex_unlock(&conn->lock);
-
-	return match;
-}
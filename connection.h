@@ -13,10 +13,14 @@
 #ifndef __KDBUS_CONNECTION_H
 #define __KDBUS_CONNECTION_H
 
+#include <linux/hashtable.h>
+#include <linux/spinlock.h>
+
 #include "defaults.h"
 #include "util.h"
 #include "metadata.h"
 #include "pool.h"
+#include "rhash.h"
 
 /**
  * struct kdbus_conn - connection to a bus
@@ -31,7 +35,9 @@
  * @msg_list:		Queue of messages
  * @msg_prio_queue:	Tree of messages, sorted by priority
  * @msg_prio_highest:	Cached entry for highest priority (lowest value) node
- * @hentry:		Entry in ID <-> connection map
+ * @wait:		Wake up this connection's poll() when its queue changes
+ * @hentry:		Entry in the bus's connection table
+ * @bus_entry:		Entry in the bus's list of connections
  * @monitor_entry:	The connection is a monitor
  * @names_list:		List of well-known names
  * @names_queue_list:	Well-known names this connection waits for
@@ -43,13 +49,26 @@
  * @work:		Support for poll()
  * @timer:		Message reply timeout handling
  * @match_db:		Subscription filter to broadcast messages
+ * @match_gen:		Generation of the match index this connection was last
+ *			collected as a broadcast candidate in
+ * @match_entry:	Entry in the list of broadcast candidates
  * @meta:		Active connection creator's metadata/credentials,
  *			either from the handle of from HELLO
  * @owner_meta:		The connection's metadata/credentials supplied by
  *			HELLO
  * @msg_count:		Number of queued messages
  * @pool:		The user's buffer to receive messages
+ * @ring:		Submission and completion rings, set up on request
+ * @stage:		Buffer to build the header of incoming messages in
+ * @stage_size:		Allocated size of @stage
+ * @arena:		The bus's broadcast arena, once the connection has
+ *			set it up to receive payloads in it
+ * @arena_lock:		Protects @arena_refs
+ * @arena_refs:		Messages in the pool which reference arena slices,
+ *			hashed by their offset in the pool
  * @user:		Owner of the connection;
+ * @rcu:		RCU head, connections are freed after a grace period,
+ *			so they can be pinned from RCU-protected lookups
  */
 struct kdbus_conn {
 	struct kref kref;
@@ -63,7 +82,9 @@ struct kdbus_conn {
 	struct list_head msg_list;
 	struct rb_root msg_prio_queue;
 	struct rb_node *msg_prio_highest;
-	struct hlist_node hentry;
+	wait_queue_head_t wait;
+	struct kdbus_rhash_node hentry;
+	struct list_head bus_entry;
 	struct list_head monitor_entry;
 	struct list_head names_list;
 	struct list_head names_queue_list;
@@ -73,16 +94,26 @@ struct kdbus_conn {
 	struct work_struct work;
 	struct timer_list timer;
 	struct kdbus_match_db *match_db;
+	u64 match_gen;
+	struct list_head match_entry;
 	struct kdbus_meta *meta;
 	struct kdbus_meta *owner_meta;
 	unsigned int msg_count;
 	struct kdbus_pool *pool;
+	struct kdbus_ring *ring;
+	void *stage;
+	size_t stage_size;
+	struct kdbus_arena *arena;
+	spinlock_t arena_lock;
+	DECLARE_HASHTABLE(arena_refs, 4);
 	struct kdbus_ns_user *user;
 	void *security;
+	struct rcu_head rcu;
 };
 
 struct kdbus_kmsg;
 struct kdbus_conn_queue;
+struct kdbus_ring;
 struct kdbus_name_registry;
 
 int kdbus_conn_new(struct kdbus_ep *ep,
@@ -90,22 +121,32 @@ int kdbus_conn_new(struct kdbus_ep *ep,
 		   struct kdbus_meta *meta,
 		   struct kdbus_conn **conn);
 struct kdbus_conn *kdbus_conn_ref(struct kdbus_conn *conn);
+struct kdbus_conn *kdbus_conn_ref_rcu(struct kdbus_conn *conn);
 struct kdbus_conn *kdbus_conn_unref(struct kdbus_conn *conn);
 int kdbus_conn_disconnect(struct kdbus_conn *conn, bool ensure_msg_list_empty);
 bool kdbus_conn_active(struct kdbus_conn *conn);
 
 int kdbus_conn_recv_msg_user(struct kdbus_conn *conn,
 			     struct kdbus_cmd_recv __user *recv);
+int kdbus_conn_recv_msg_batch_user(struct kdbus_conn *conn,
+				   struct kdbus_cmd_recv_batch __user *batch);
+int kdbus_conn_ring_setup_user(struct kdbus_conn *conn,
+			       struct kdbus_cmd_ring __user *buf);
+int kdbus_conn_ring_enter(struct kdbus_conn *conn);
+int kdbus_conn_arena_setup_user(struct kdbus_conn *conn,
+				struct kdbus_cmd_arena __user *buf);
+int kdbus_conn_free_range(struct kdbus_conn *conn, size_t off);
 int kdbus_cmd_conn_info(struct kdbus_conn *conn,
 			void __user *buf);
 int kdbus_conn_kmsg_send(struct kdbus_ep *ep,
 			 struct kdbus_conn *conn_src,
 			 struct kdbus_kmsg *kmsg);
+int kdbus_conn_kmsg_send_batch_user(struct kdbus_conn *conn,
+				    struct kdbus_cmd_send_batch __user *batch);
 void kdbus_conn_kmsg_list_free(struct list_head *kmsg_list);
 int kdbus_conn_kmsg_list_send(struct kdbus_ep *ep,
 			      struct list_head *kmsg_list);
 int kdbus_conn_move_messages(struct kdbus_conn *conn_dst,
 			     struct kdbus_conn *conn_src,
 			     u64 name_id);
-bool kdbus_conn_has_name(struct kdbus_conn *conn, const char *name);
 #endif
@@ -16,6 +16,30 @@
 /* maximum size of message header and items */
 #define KDBUS_MSG_MAX_SIZE		SZ_8K
 
+/* maximum number of messages submitted with one KDBUS_CMD_MSG_SEND_BATCH */
+#define KDBUS_MSG_MAX_BATCH		256
+
+/* maximum number of entries of the submission and completion rings */
+#define KDBUS_RING_MAX_ENTRIES		4096
+
+/* size of the broadcast arena of buses created with KDBUS_MAKE_ARENA */
+#define KDBUS_BUS_ARENA_SIZE		SZ_16M
+
+/* minimum payload size of a broadcast to store it in the arena */
+#define KDBUS_ARENA_MIN_SIZE		SZ_1K
+
+/* distance of the arena mapping from the end of the pool, room for the rings */
+#define KDBUS_ARENA_MAP_GAP		SZ_1M
+
+/* minimum number of broadcast receivers per CPU to deliver in parallel */
+#define KDBUS_CONN_BROADCAST_BATCH	64
+
+/* maximum size of a pool created with KDBUS_HELLO_POOL_MAPPED */
+#define KDBUS_POOL_MAPPED_MAX_SIZE	SZ_64M
+
+/* minimum size of a free pool region to give its memory back */
+#define KDBUS_POOL_RELEASE_MIN		SZ_256K
+
 /* maximum number of message items */
 #define KDBUS_MSG_MAX_ITEMS		128
 
@@ -43,6 +67,9 @@
 /* maximum size of policy data */
 #define KDBUS_POLICY_MAX_SIZE		SZ_32K
 
+/* maximum size of one batch of the name list */
+#define KDBUS_NAME_LIST_BATCH_MAX_SIZE	SZ_256K
+
 /* maximum number of queued messages per connection */
 #define KDBUS_CONN_MAX_MSGS		64
 
@@ -21,6 +21,7 @@
 #include <linux/uaccess.h>
 
 #include "bus.h"
+#include "connection.h"
 #include "endpoint.h"
 #include "namespace.h"
 #include "policy.h"
@@ -64,6 +65,8 @@ struct kdbus_ep *kdbus_ep_ref(struct kdbus_ep *ep)
  */
 void kdbus_ep_disconnect(struct kdbus_ep *ep)
 {
+	struct kdbus_conn *conn;
+
 	mutex_lock(&ep->lock);
 	if (ep->disconnected) {
 		mutex_unlock(&ep->lock);
@@ -73,10 +76,17 @@ void kdbus_ep_disconnect(struct kdbus_ep *ep)
 	ep->disconnected = true;
 	mutex_unlock(&ep->lock);
 
-	/* disconnect from bus */
+	/*
+	 * Disconnect from bus, and wake up the connections of this endpoint
+	 * so they can report POLLERR to their users.
+	 */
 	mutex_lock(&ep->bus->lock);
 	if (ep->bus)
 		list_del(&ep->bus_entry);
+	list_for_each_entry(conn, &ep->bus->conn_list, bus_entry) {
+		if (conn->ep == ep)
+			wake_up_interruptible(&conn->wait);
+	}
 	mutex_unlock(&ep->bus->lock);
 
 	if (ep->dev) {
@@ -87,12 +97,6 @@ void kdbus_ep_disconnect(struct kdbus_ep *ep)
 		idr_remove(&ep->bus->ns->idr, ep->minor);
 		ep->minor = 0;
 	}
-
-	/*
-	 * wake up the queue so the connections can report
-	 * POLLERR to their users.
-	 */
-	wake_up_interruptible(&ep->wait);
 }
 
 static void __kdbus_ep_free(struct kref *kref)
@@ -170,7 +174,6 @@ int kdbus_ep_new(struct kdbus_bus *bus, struct kdbus_ns *ns, const char *name,
 	e->uid = uid;
 	e->gid = gid;
 	e->mode = mode;
-	init_waitqueue_head(&e->wait);
 
 	e->name = kstrdup(name, GFP_KERNEL);
 	if (!e->name) {
@@ -29,7 +29,6 @@
  * @uid			uid owning this endpoint
  * @gid			gid owning this endpoint
  * @bus_entry		bus' endpoints
- * @wait		wake up this endpoint
  * @lock		endpoint data lock
  * @policy_db		uploaded policy
  * @policy_open		default endpoint policy
@@ -50,7 +49,6 @@ struct kdbus_ep {
 	kuid_t uid;
 	kgid_t gid;
 	struct list_head bus_entry;
-	wait_queue_head_t wait;
 	struct mutex lock;
 	struct kdbus_policy_db *policy_db;
 	bool policy_open:1;
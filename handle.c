@@ -24,6 +24,7 @@
 #include <linux/uaccess.h>
 #include <linux/syscalls.h>
 
+#include "arena.h"
 #include "bus.h"
 #include "connection.h"
 #include "endpoint.h"
@@ -36,6 +37,8 @@
 #include "namespace.h"
 #include "notify.h"
 #include "policy.h"
+#include "pool.h"
+#include "ring.h"
 
 /**
  * enum kdbus_handle_type - type a handle can be of
@@ -534,7 +537,8 @@ static long kdbus_handle_ioctl_ep_connected(struct file *file, unsigned int cmd,
 				break;
 		}
 
-		ret = kdbus_cmd_policy_set_from_user(conn->ep->policy_db, buf);
+		ret = kdbus_cmd_policy_set_from_user(conn->ep->policy_db,
+						     bus->name_registry, buf);
 		break;
 
 	case KDBUS_CMD_NAME_ACQUIRE:
@@ -567,6 +571,16 @@ static long kdbus_handle_ioctl_ep_connected(struct file *file, unsigned int cmd,
 		ret = kdbus_cmd_name_list(bus->name_registry, conn, buf);
 		break;
 
+	case KDBUS_CMD_NAME_LIST_BATCH:
+		/* query the IDs and names, one batch at a time */
+		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = kdbus_cmd_name_list_batch(bus->name_registry, conn, buf);
+		break;
+
 	case KDBUS_CMD_CONN_INFO:
 		/* return the properties of a connection */
 		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
@@ -597,6 +611,16 @@ static long kdbus_handle_ioctl_ep_connected(struct file *file, unsigned int cmd,
 		ret = kdbus_match_db_remove(conn, buf);
 		break;
 
+	case KDBUS_CMD_MATCH_STATS:
+		/* return the counters of the match database */
+		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = kdbus_cmd_match_stats(conn, buf);
+		break;
+
 	case KDBUS_CMD_MSG_SEND: {
 		/* submit a message which will be queued in the receiver */
 		struct kdbus_kmsg *kmsg = NULL;
@@ -630,6 +654,41 @@ static long kdbus_handle_ioctl_ep_connected(struct file *file, unsigned int cmd,
 		break;
 	}
 
+	case KDBUS_CMD_MSG_SEND_BATCH:
+		/* submit multiple messages */
+		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = kdbus_conn_kmsg_send_batch_user(conn, buf);
+		break;
+
+	case KDBUS_CMD_RING_SETUP:
+		/* create the submission and completion rings */
+		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = kdbus_conn_ring_setup_user(conn, buf);
+		break;
+
+	case KDBUS_CMD_ARENA_SETUP:
+		/* receive broadcast payloads in the bus's arena */
+		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = kdbus_conn_arena_setup_user(conn, buf);
+		break;
+
+	case KDBUS_CMD_RING_ENTER:
+		/* process the submission ring */
+		ret = kdbus_conn_ring_enter(conn);
+		break;
+
 	case KDBUS_CMD_MSG_RECV:
 		/* handle a queued message */
 		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
@@ -640,6 +699,16 @@ static long kdbus_handle_ioctl_ep_connected(struct file *file, unsigned int cmd,
 		ret = kdbus_conn_recv_msg_user(conn, buf);
 		break;
 
+	case KDBUS_CMD_MSG_RECV_BATCH:
+		/* handle multiple queued messages */
+		if (!KDBUS_IS_ALIGNED8((uintptr_t)buf)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = kdbus_conn_recv_msg_batch_user(conn, buf);
+		break;
+
 	case KDBUS_CMD_FREE: {
 		u64 off;
 
@@ -654,7 +723,7 @@ static long kdbus_handle_ioctl_ep_connected(struct file *file, unsigned int cmd,
 			break;
 		}
 
-		ret = kdbus_pool_free_range(conn->pool, off);
+		ret = kdbus_conn_free_range(conn, off);
 		break;
 	}
 
@@ -695,9 +764,9 @@ static unsigned int kdbus_handle_poll(struct file *file,
 				      struct poll_table_struct *wait)
 {
 	struct kdbus_handle *handle = file->private_data;
+	struct kdbus_ring *ring;
 	struct kdbus_conn *conn;
 	unsigned int mask = 0;
-	bool disconnected;
 
 	/* Only a connected endpoint can read/write data */
 	if (handle->type != KDBUS_HANDLE_EP_CONNECTED)
@@ -705,20 +774,28 @@ static unsigned int kdbus_handle_poll(struct file *file,
 
 	conn = handle->conn;
 
-	poll_wait(file, &conn->ep->wait, wait);
-
-	mutex_lock(&conn->lock);
+	poll_wait(file, &conn->wait, wait);
 
-	mutex_lock(&conn->ep->lock);
-	disconnected = conn->ep->disconnected;
-	mutex_unlock(&conn->ep->lock);
-
-	if (unlikely(disconnected))
+	/*
+	 * Readiness is sampled without taking conn->lock or ep->lock; every
+	 * state change below is followed by a wakeup of conn->wait, so a
+	 * stale read is corrected by the next call to poll().
+	 */
+	if (unlikely(ACCESS_ONCE(conn->ep->disconnected) ||
+		     ACCESS_ONCE(conn->disconnected)))
 		mask |= POLLERR | POLLHUP;
-	else if (!list_empty(&conn->msg_list))
+	else if (ACCESS_ONCE(conn->msg_count) > 0)
 		mask |= POLLIN | POLLRDNORM;
 
-	mutex_unlock(&conn->lock);
+	/*
+	 * With rings, poll() reports unconsumed completions. It never
+	 * processes submissions: the operations depend on the calling task,
+	 * which need not be the one owning the ring, so they are only run by
+	 * KDBUS_CMD_RING_ENTER.
+	 */
+	ring = ACCESS_ONCE(conn->ring);
+	if (ring && !(mask & POLLERR) && kdbus_ring_cq_pending(ring))
+		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
@@ -726,14 +803,34 @@ static unsigned int kdbus_handle_poll(struct file *file,
 static int kdbus_handle_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	struct kdbus_handle *handle = file->private_data;
+	struct kdbus_conn *conn = handle->conn;
+	struct kdbus_arena *arena;
+	struct kdbus_ring *ring;
 
 	if (handle->type != KDBUS_HANDLE_EP_CONNECTED)
 		return -EPERM;
 
-	if (handle->conn->flags & KDBUS_HELLO_ACTIVATOR)
+	if (conn->flags & KDBUS_HELLO_ACTIVATOR)
 		return -EPERM;
 
-	return kdbus_pool_mmap(handle->conn->pool, vma);
+	/* the arena is mapped behind the pool and the rings */
+	arena = ACCESS_ONCE(conn->arena);
+	if (arena) {
+		size_t off = kdbus_pool_size(conn->pool) + KDBUS_ARENA_MAP_GAP;
+
+		if (((u64)vma->vm_pgoff << PAGE_SHIFT) == off)
+			return kdbus_arena_mmap(arena, vma, off);
+	}
+
+	/* the rings are mapped at the offset right behind the pool */
+	ring = ACCESS_ONCE(conn->ring);
+	if (ring && ((u64)vma->vm_pgoff << PAGE_SHIFT) ==
+		    kdbus_pool_size(conn->pool)) {
+		smp_rmb();
+		return kdbus_ring_mmap(ring, vma);
+	}
+
+	return kdbus_pool_mmap(conn->pool, vma);
 }
 
 const struct file_operations kdbus_device_ops = {
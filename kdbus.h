@@ -209,6 +209,8 @@ struct kdbus_policy {
  * @KDBUS_ITEM_DST_NAME:	Destination's well-known name
  * @KDBUS_ITEM_MAKE_NAME:	Name of namespace, bus, endpoint
  * @KDBUS_ITEM_MEMFD_NAME:	The human readable name of a memfd (debugging)
+ * @KDBUS_ITEM_PAYLOAD_ARENA:	Data at returned offset to the start of the
+ *				bus's broadcast arena mapping
  * @_KDBUS_ITEM_POLICY_BASE:	Start of policy items
  * @KDBUS_ITEM_POLICY_NAME:	Policy in struct kdbus_policy
  * @KDBUS_ITEM_POLICY_ACCESS:	Policy in struct kdbus_policy
@@ -247,6 +249,7 @@ enum kdbus_item_type {
 	KDBUS_ITEM_DST_NAME,
 	KDBUS_ITEM_MAKE_NAME,
 	KDBUS_ITEM_MEMFD_NAME,
+	KDBUS_ITEM_PAYLOAD_ARENA,
 
 	_KDBUS_ITEM_POLICY_BASE	= 0x1000,
 	KDBUS_ITEM_POLICY_NAME = _KDBUS_ITEM_POLICY_BASE,
@@ -397,6 +400,137 @@ struct kdbus_msg {
 	struct kdbus_item items[0];
 } __attribute__((aligned(8)));
 
+/**
+ * struct kdbus_cmd_send_batch - struct to send multiple messages
+ * @flags:		Currently unused, must be zero
+ * @count:		The number of elements in the @msgs and @results
+ *			arrays
+ * @msgs:		Userspace address of an array of __u64, each of which
+ *			is the userspace address of a struct kdbus_msg. Every
+ *			message must be aligned to 8 bytes. Messages flagged
+ *			with KDBUS_MSG_FLAGS_SYNC_REPLY are not supported.
+ * @results:		Userspace address of an array of __s64, which receives
+ *			the result of every message: 0 on success, or the
+ *			negative errno KDBUS_CMD_MSG_SEND would have returned
+ *
+ * This struct is used with the KDBUS_CMD_MSG_SEND_BATCH ioctl.
+ */
+struct kdbus_cmd_send_batch {
+	__u64 flags;
+	__u64 count;
+	__u64 msgs;
+	__u64 results;
+} __attribute__((aligned(8)));
+
+/**
+ * enum kdbus_ring_op - operations of the submission ring
+ * @_KDBUS_RING_OP_NULL:	Uninitialized/invalid
+ * @KDBUS_RING_OP_SEND:		Send the struct kdbus_msg found at the
+ *				userspace address stored in @arg, like
+ *				KDBUS_CMD_MSG_SEND. Messages flagged with
+ *				KDBUS_MSG_FLAGS_SYNC_REPLY are not supported.
+ * @KDBUS_RING_OP_RECV:		Receive a message, like KDBUS_CMD_MSG_RECV;
+ *				@flags carries the KDBUS_RECV_* flags, @arg
+ *				the priority.
+ * @KDBUS_RING_OP_FREE:		Release the pool slice at the offset stored in
+ *				@arg, like KDBUS_CMD_FREE.
+ */
+enum kdbus_ring_op {
+	_KDBUS_RING_OP_NULL,
+	KDBUS_RING_OP_SEND,
+	KDBUS_RING_OP_RECV,
+	KDBUS_RING_OP_FREE,
+};
+
+/**
+ * struct kdbus_ring_sqe - submission ring entry
+ * @op:			The operation to perform (KDBUS_RING_OP_*)
+ * @flags:		Flags of the operation
+ * @arg:		Argument of the operation
+ * @user_data:		Opaque value, returned in the completion ring entry
+ */
+struct kdbus_ring_sqe {
+	__u64 op;
+	__u64 flags;
+	__u64 arg;
+	__u64 user_data;
+} __attribute__((aligned(8)));
+
+/**
+ * struct kdbus_ring_cqe - completion ring entry
+ * @user_data:		The value of the submission ring entry
+ * @result:		0 on success, or the negative errno the matching
+ *			ioctl would have returned
+ * @offset:		The offset of the received message in the pool, only
+ *			valid for successful KDBUS_RING_OP_RECV operations
+ */
+struct kdbus_ring_cqe {
+	__u64 user_data;
+	__s64 result;
+	__u64 offset;
+} __attribute__((aligned(8)));
+
+/**
+ * struct kdbus_ring_ctl - indices of a ring
+ * @head:		Index of the next entry to consume
+ * @tail:		Index of the next entry to produce
+ *
+ * The indices are free-running counters; the array slot of an index is the
+ * index modulo the number of ring entries. Userspace produces submission
+ * entries and consumes completion entries; it must only ever write the tail
+ * of the submission ring and the head of the completion ring.
+ */
+struct kdbus_ring_ctl {
+	__u64 head;
+	__u64 tail;
+} __attribute__((aligned(8)));
+
+/**
+ * struct kdbus_cmd_ring - struct to set up the submission and completion rings
+ * @flags:		Currently unused, must be zero
+ * @entries:		The number of entries of each ring, must be a power
+ *			of two
+ * @offset:		Returned offset to pass to mmap() to map the rings
+ * @size:		Returned size of the ring mapping
+ * @sq_off:		Returned offset of the submission ring's
+ *			struct kdbus_ring_ctl inside the mapping
+ * @sqes_off:		Returned offset of the submission ring's array of
+ *			struct kdbus_ring_sqe inside the mapping
+ * @cq_off:		Returned offset of the completion ring's
+ *			struct kdbus_ring_ctl inside the mapping
+ * @cqes_off:		Returned offset of the completion ring's array of
+ *			struct kdbus_ring_cqe inside the mapping
+ *
+ * This struct is used with the KDBUS_CMD_RING_SETUP ioctl.
+ */
+struct kdbus_cmd_ring {
+	__u64 flags;
+	__u64 entries;
+	__u64 offset;
+	__u64 size;
+	__u64 sq_off;
+	__u64 sqes_off;
+	__u64 cq_off;
+	__u64 cqes_off;
+} __attribute__((aligned(8)));
+
+/**
+ * struct kdbus_cmd_arena - struct to map the broadcast arena of the bus
+ * @flags:		Flags for the arena, must be 0
+ * @offset:		Returned offset to pass to mmap() to map the arena
+ * @size:		Returned size of the arena
+ *
+ * This struct is used with the KDBUS_CMD_ARENA_SETUP ioctl. After the call,
+ * the payload of broadcast messages may be delivered as
+ * KDBUS_ITEM_PAYLOAD_ARENA items, which point into the read-only mapping of
+ * the arena instead of the receiver's pool.
+ */
+struct kdbus_cmd_arena {
+	__u64 flags;
+	__u64 offset;
+	__u64 size;
+} __attribute__((aligned(8)));
+
 /**
  * enum kdbus_recv_flags - flags for de-queuing messages
  * @KDBUS_RECV_PEEK:		Return the next queued message without
@@ -433,6 +567,27 @@ struct kdbus_cmd_recv {
 	__u64 offset;
 } __attribute__((aligned(8)));
 
+/**
+ * struct kdbus_cmd_recv_batch - struct to de-queue multiple buffered messages
+ * @flags:		KDBUS_RECV_* flags, KDBUS_RECV_PEEK is not supported
+ * @priority:		Minimum priority of the messages to de-queue, as in
+ *			struct kdbus_cmd_recv
+ * @count:		The number of elements in the @offsets array; the
+ *			kernel returns the number of de-queued messages
+ * @offsets:		Userspace address of an array of __u64, which
+ *			receives the offsets of the de-queued messages in the
+ *			pool, in the order they were de-queued. Every offset
+ *			must be released with KDBUS_CMD_FREE.
+ *
+ * This struct is used with the KDBUS_CMD_MSG_RECV_BATCH ioctl.
+ */
+struct kdbus_cmd_recv_batch {
+	__u64 flags;
+	__s64 priority;
+	__u64 count;
+	__u64 offsets;
+} __attribute__((aligned(8)));
+
 /**
  * enum kdbus_policy_access_type - permissions of a policy record
  * @_KDBUS_POLICY_ACCESS_NULL:	Uninitialized/invalid
@@ -482,11 +637,19 @@ struct kdbus_cmd_policy {
  *				when traffic arrives
  * @KDBUS_HELLO_MONITOR:	Special-purpose connection to monitor
  *				bus traffic
+ * @KDBUS_HELLO_POOL_FIFO:	Use the pool as a ring buffer; for receivers
+ *				which free their messages in the order of
+ *				arrival
+ * @KDBUS_HELLO_POOL_MAPPED:	Populate and pin the entire pool at HELLO, to
+ *				let senders copy to it with less overhead;
+ *				requires privileges or CAP_IPC_LOCK
  */
 enum kdbus_hello_flags {
 	KDBUS_HELLO_ACCEPT_FD		=  1 <<  0,
 	KDBUS_HELLO_ACTIVATOR		=  1 <<  1,
 	KDBUS_HELLO_MONITOR		=  1 <<  2,
+	KDBUS_HELLO_POOL_FIFO		=  1 <<  3,
+	KDBUS_HELLO_POOL_MAPPED		=  1 <<  4,
 };
 
 /**
@@ -555,6 +718,7 @@ enum kdbus_make_flags {
 	KDBUS_MAKE_ACCESS_GROUP		= 1 <<  0,
 	KDBUS_MAKE_ACCESS_WORLD		= 1 <<  1,
 	KDBUS_MAKE_POLICY_OPEN		= 1 <<  2,
+	KDBUS_MAKE_ARENA		= 1 <<  3,
 };
 
 /**
@@ -649,6 +813,32 @@ struct kdbus_name_list {
 	struct kdbus_cmd_name names[0];
 };
 
+/**
+ * struct kdbus_cmd_name_list_batch - request one batch of the name list
+ * @size:		The total size of the struct
+ * @flags:		Flags for the query (KDBUS_NAME_LIST_*)
+ * @max_size:		Maximum size of the returned struct kdbus_name_list
+ * @cursor:		In: where to continue the list, 0 to start it.
+ *			Out: the value to pass for the next batch, 0 if the
+ *			list is complete
+ * @offset:		The returned offset in the caller's pool buffer of
+ *			the struct kdbus_name_list. The user must use
+ *			KDBUS_CMD_FREE to free the allocated memory.
+ *
+ * This structure is used with the KDBUS_CMD_NAME_LIST_BATCH ioctl. The
+ * connections are listed in the order of their IDs, and all records of
+ * one connection are returned in the same batch. Every connection which
+ * stays on the bus for the whole walk is listed exactly once; connections
+ * which come or go during the walk may or may not be listed.
+ */
+struct kdbus_cmd_name_list_batch {
+	__u64 size;
+	__u64 flags;
+	__u64 max_size;
+	__u64 cursor;
+	__u64 offset;
+} __attribute__((aligned(8)));
+
 /**
  * struct kdbus_cmd_conn_info - struct used for KDBUS_CMD_CONN_INFO ioctl
  * @size:		The total size of the struct
@@ -710,6 +900,74 @@ struct kdbus_cmd_match {
 	struct kdbus_item items[0];
 } __attribute__((aligned(8)));
 
+/**
+ * enum kdbus_match_stats_flags - flags for KDBUS_CMD_MATCH_STATS
+ * @KDBUS_MATCH_STATS_BUS:	Return the totals of all connections on the
+ *				bus, including the ones already gone, instead
+ *				of the counters of one connection
+ */
+enum kdbus_match_stats_flags {
+	KDBUS_MATCH_STATS_BUS		= 1 <<  0,
+};
+
+/**
+ * struct kdbus_cmd_match_stats - query the counters of a match database
+ * @size:		The total size of the struct
+ * @flags:		Flags for the query (KDBUS_MATCH_STATS_*)
+ * @owner_id:		The connection to query, 0 for the caller. Privileged
+ *			users may query the counters of other peers
+ * @offset:		The returned offset in the caller's pool buffer of
+ *			the struct kdbus_match_stats result. The user must
+ *			use KDBUS_CMD_FREE to free the allocated memory.
+ *
+ * This structure is used with the KDBUS_CMD_MATCH_STATS ioctl.
+ */
+struct kdbus_cmd_match_stats {
+	__u64 size;
+	__u64 flags;
+	__u64 owner_id;
+	__u64 offset;
+} __attribute__((aligned(8)));
+
+/**
+ * struct kdbus_match_entry_stats - counters of one match entry
+ * @cookie:		The cookie the entry was added with
+ * @hits:		Number of broadcasts the entry let through
+ */
+struct kdbus_match_entry_stats {
+	__u64 cookie;
+	__u64 hits;
+};
+
+/**
+ * struct kdbus_match_stats - information returned by KDBUS_CMD_MATCH_STATS
+ * @size:		The total size of the structure
+ * @evaluated:		Number of broadcasts checked against the match entries
+ * @matched:		Number of broadcasts which matched an entry
+ * @bloom_checked:	Number of bloom masks of entries checked against the
+ *			bloom filter of a message; entries without a bloom
+ *			rule have an empty mask, which always matches
+ * @bloom_hits:		Number of bloom masks which matched
+ * @entries:		The counters of every match entry of the connection,
+ *			empty for KDBUS_MATCH_STATS_BUS
+ *
+ * Only the first matching entry of a connection is counted as hit for a
+ * broadcast. Entries with a high share of @hits compared to @evaluated,
+ * whose messages are then dropped by the receiver, have bloom masks that are
+ * too broad.
+ *
+ * Note that the user is responsible for freeing the allocated memory with
+ * the KDBUS_CMD_FREE ioctl.
+ */
+struct kdbus_match_stats {
+	__u64 size;
+	__u64 evaluated;
+	__u64 matched;
+	__u64 bloom_checked;
+	__u64 bloom_hits;
+	struct kdbus_match_entry_stats entries[0];
+};
+
 /**
  * struct kdbus_cmd_memfd_make - create a kdbus memfd
  * @size:		The total size of the struct
@@ -755,6 +1013,22 @@ struct kdbus_cmd_memfd_make {
  *				placed in the receiver's pool.
  * @KDBUS_CMD_FREE:		Release the allocated memory in the receiver's
  *				pool.
+ * @KDBUS_CMD_MSG_RECV_BATCH:	Receive up to a given number of messages with
+ *				a single call, in queue order, or in priority
+ *				order if KDBUS_RECV_USE_PRIORITY is set.
+ * @KDBUS_CMD_MSG_SEND_BATCH:	Send multiple messages with a single call. The
+ *				result of every message is reported
+ *				individually.
+ * @KDBUS_CMD_RING_SETUP:	Create the submission and completion rings of
+ *				a connection, which are mapped with mmap()
+ *				next to the pool.
+ * @KDBUS_CMD_RING_ENTER:	Process all pending entries of the submission
+ *				ring and post their results to the completion
+ *				ring. Returns the number of processed entries.
+ * @KDBUS_CMD_ARENA_SETUP:	Receive the payload of large broadcasts in the
+ *				bus's shared arena, which is mapped read-only
+ *				with mmap() next to the pool. Only available on
+ *				buses created with KDBUS_MAKE_ARENA.
  * @KDBUS_CMD_NAME_ACQUIRE:	Request a well-known bus name to associate with
  *				the connection. Well-known names are used to
  *				address a peer on the bus.
@@ -762,6 +1036,9 @@ struct kdbus_cmd_memfd_make {
  *				currently owns.
  * @KDBUS_CMD_NAME_LIST:	Retrieve the list of all currently registered
  *				well-known and unique names.
+ * @KDBUS_CMD_NAME_LIST_BATCH:	Retrieve the same list in batches of bounded
+ *				size, continuing at a cursor; the bus is not
+ *				locked for the whole walk.
  * @KDBUS_CMD_CONN_INFO:	Retrieve credentials and properties of the
  *				initial creator of the connection. The data was
  *				stored at registration time and does not
@@ -770,6 +1047,8 @@ struct kdbus_cmd_memfd_make {
  * @KDBUS_CMD_MATCH_ADD:	Install a match which broadcast messages should
  *				be delivered to the connection.
  * @KDBUS_CMD_MATCH_REMOVE:	Remove a current match for broadcast messages.
+ * @KDBUS_CMD_MATCH_STATS:	Retrieve the counters of the matches of a
+ *				connection, or the totals of the bus.
  * @KDBUS_CMD_EP_POLICY_SET:	Set the policy of an endpoint. It is used to
  *				restrict the access for endpoints created with
  *				KDBUS_CMD_EP_MAKE.
@@ -811,15 +1090,22 @@ enum kdbus_ioctl_type {
 	KDBUS_CMD_MSG_SEND =		_IOW (KDBUS_IOC_MAGIC, 0x40, struct kdbus_msg),
 	KDBUS_CMD_MSG_RECV =		_IOWR(KDBUS_IOC_MAGIC, 0x41, struct kdbus_cmd_recv),
 	KDBUS_CMD_FREE =		_IOW (KDBUS_IOC_MAGIC, 0x42, __u64 *),
+	KDBUS_CMD_MSG_RECV_BATCH =	_IOWR(KDBUS_IOC_MAGIC, 0x43, struct kdbus_cmd_recv_batch),
+	KDBUS_CMD_MSG_SEND_BATCH =	_IOW (KDBUS_IOC_MAGIC, 0x44, struct kdbus_cmd_send_batch),
+	KDBUS_CMD_RING_SETUP =		_IOWR(KDBUS_IOC_MAGIC, 0x45, struct kdbus_cmd_ring),
+	KDBUS_CMD_RING_ENTER =		_IO  (KDBUS_IOC_MAGIC, 0x46),
+	KDBUS_CMD_ARENA_SETUP =		_IOWR(KDBUS_IOC_MAGIC, 0x47, struct kdbus_cmd_arena),
 
 	KDBUS_CMD_NAME_ACQUIRE =	_IOWR(KDBUS_IOC_MAGIC, 0x50, struct kdbus_cmd_name),
 	KDBUS_CMD_NAME_RELEASE =	_IOW (KDBUS_IOC_MAGIC, 0x51, struct kdbus_cmd_name),
 	KDBUS_CMD_NAME_LIST =		_IOWR(KDBUS_IOC_MAGIC, 0x52, struct kdbus_cmd_name_list),
+	KDBUS_CMD_NAME_LIST_BATCH =	_IOWR(KDBUS_IOC_MAGIC, 0x53, struct kdbus_cmd_name_list_batch),
 
 	KDBUS_CMD_CONN_INFO =		_IOWR(KDBUS_IOC_MAGIC, 0x60, struct kdbus_cmd_conn_info),
 
 	KDBUS_CMD_MATCH_ADD =		_IOW (KDBUS_IOC_MAGIC, 0x70, struct kdbus_cmd_match),
 	KDBUS_CMD_MATCH_REMOVE =	_IOW (KDBUS_IOC_MAGIC, 0x71, struct kdbus_cmd_match),
+	KDBUS_CMD_MATCH_STATS =		_IOWR(KDBUS_IOC_MAGIC, 0x72, struct kdbus_cmd_match_stats),
 
 	KDBUS_CMD_EP_POLICY_SET =	_IOW (KDBUS_IOC_MAGIC, 0x80, struct kdbus_cmd_policy),
 
@@ -10,14 +10,19 @@
  * your option) any later version.
  */
 
+#include <linux/bitops.h>
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/hash.h>
+#include <linux/hashtable.h>
 #include <linux/init.h>
+#include <linux/kernel.h>
 #include <linux/mutex.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/sizes.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/uaccess.h>
 
 #include "bus.h"
@@ -25,15 +30,184 @@
 #include "endpoint.h"
 #include "match.h"
 #include "message.h"
+#include "names.h"
+#include "pool.h"
+
+/**
+ * struct kdbus_match_counters - counters of matching broadcasts
+ * @evaluated:		Number of broadcasts checked against a database
+ * @matched:		Number of broadcasts which matched an entry
+ * @bloom_checked:	Number of bloom masks checked
+ * @bloom_hits:		Number of bloom masks which matched
+ */
+struct kdbus_match_counters {
+	atomic64_t		evaluated;
+	atomic64_t		matched;
+	atomic64_t		bloom_checked;
+	atomic64_t		bloom_hits;
+};
 
 /**
  * struct kdbus_match_db - message filters
  * @entries_list:	List of matches
- * @entries_lock:	Match data lock
+ * @entries_lock:	Match data lock, taken by writers only
+ * @prog:		The entries compiled for matching, rebuilt whenever
+ *			@entries_list changes and published with RCU
+ * @counters:		Counters of the broadcasts matched against the
+ *			database
  */
 struct kdbus_match_db {
-	struct list_head	entries_list;
-	struct mutex		entries_lock;
+	struct list_head		entries_list;
+	struct mutex			entries_lock;
+	struct kdbus_match_prog __rcu	*prog;
+	struct kdbus_match_counters	counters;
+};
+
+/**
+ * struct kdbus_match_prog_entry - compiled entry for messages from userspace
+ * @src_id:		The sender ID all ID rules ask for, or
+ *			KDBUS_MATCH_ID_ANY
+ * @slot:		Position of the entry's bloom mask while compiling,
+ *			before the entries are sorted
+ * @names:		Index of the first name in the names of the program
+ * @n_names:		Number of names the sender must own
+ * @hits:		The hit counter of the match entry
+ */
+struct kdbus_match_prog_entry {
+	u64			src_id;
+	unsigned int		slot;
+	unsigned int		names;
+	unsigned int		n_names;
+	atomic64_t		*hits;
+};
+
+/**
+ * struct kdbus_match_prog_notify - compiled entry for kernel notifications
+ * @type:		The notification type, or 0 for an entry without rules
+ * @old_id:		The old ID all rules ask for, or KDBUS_MATCH_ID_ANY
+ * @new_id:		The new ID all rules ask for, or KDBUS_MATCH_ID_ANY
+ * @name:		The name all rules ask for, or NULL
+ * @hits:		The hit counter of the match entry
+ */
+struct kdbus_match_prog_notify {
+	u64			type;
+	u64			old_id;
+	u64			new_id;
+	const struct kdbus_name_atom *name;
+	atomic64_t		*hits;
+};
+
+/**
+ * struct kdbus_match_prog - compiled match database
+ * @entries:		Entries for messages from userspace, sorted by the
+ *			sender ID they ask for; entries for any sender are at
+ *			the end
+ * @n_entries:		Number of entries in @entries
+ * @n_ids:		Number of entries in @entries which ask for a specific
+ *			sender ID
+ * @notify:		Entries for kernel notifications
+ * @n_notify:		Number of entries in @notify
+ * @names:		Names referenced by @entries
+ * @n_names:		Number of names in @names
+ * @blooms:		One bloom mask for every entry in @entries, in the
+ *			same order; entries without bloom rules have an empty
+ *			mask
+ * @bloom_words:	Size of one bloom mask, in u64 words
+ * @rcu:		RCU head, to free the program after all readers are
+ *			done with it
+ *
+ * All the rules of an entry are folded into one record: the bloom masks
+ * are or-ed into one mask, the ID rules into one ID and the notification
+ * rules into one prototype. Entries whose rules contradict each other can
+ * never match and are left out. A message from userspace only needs to look
+ * at the entries for its sender's ID, found with a binary search, and at
+ * the entries for any sender. The bloom masks of neighbouring entries are
+ * stored back to back, so several of them can be checked in one pass over
+ * the message's filter.
+ *
+ * The program is allocated as one block and does not reference the rules
+ * it was compiled from, only the hit counters of their entries, which are
+ * freed with RCU as well, and the atoms of their names, which are only
+ * compared, never dereferenced. It is never changed once published;
+ * writers build a new one and replace it, so readers can run it under
+ * rcu_read_lock().
+ */
+struct kdbus_match_prog {
+	struct kdbus_match_prog_entry	*entries;
+	unsigned int			n_entries;
+	unsigned int			n_ids;
+	struct kdbus_match_prog_notify	*notify;
+	unsigned int			n_notify;
+	const struct kdbus_name_atom	**names;
+	unsigned int			n_names;
+	u64				*blooms;
+	unsigned int			bloom_words;
+	struct rcu_head			rcu;
+};
+
+/**
+ * struct kdbus_match_ctx - state of matching one message from userspace
+ * @conn_src:		The sending connection
+ * @kmsg:		The message
+ * @names:		The lock of @conn_src is held, so entries with name
+ *			rules can be checked
+ * @deferred:		An entry with name rules was skipped, because @names
+ *			was not set
+ * @bloom_checked:	Number of bloom masks checked
+ * @bloom_hits:		Number of bloom masks which matched
+ */
+struct kdbus_match_ctx {
+	struct kdbus_conn		*conn_src;
+	const struct kdbus_kmsg		*kmsg;
+	bool				names;
+	bool				deferred;
+	unsigned int			bloom_checked;
+	unsigned int			bloom_hits;
+};
+
+/**
+ * struct kdbus_match_index - bus-wide index of all match entries
+ * @ids:		Entries with a rule for a sender ID, hashed by the ID
+ * @names:		Entries with a rule for a sender's well-known name,
+ *			hashed by the name
+ * @bloom:		Entries with a bloom mask, one list per bit of the
+ *			bloom filter
+ * @bloom_count:	Number of entries in each list of @bloom
+ * @bloom_bits:		Number of bits of the bloom filter
+ * @wildcard:		Entries without any key, they are looked at for every
+ *			message
+ * @notify_types:	Entries for kernel notifications without a name or an
+ *			ID, hashed by the notification type
+ * @notify_ids:		Entries for kernel notifications about a specific
+ *			connection ID, hashed by the ID
+ * @notify_names:	Entries for kernel notifications about a specific
+ *			well-known name, hashed by the name
+ * @gen:		Generation counter, used to collect every candidate
+ *			connection only once per message
+ * @retired:		Counters of the databases of connections which left
+ *			the bus
+ *
+ * Every match entry is posted in exactly one list of the index, keyed by
+ * one of its rules. A message can only match entries posted under one of
+ * its own keys: its sender's ID, its sender's names or the bits set in its
+ * bloom filter. Entries with a bloom mask are posted under the bit of the
+ * mask with the shortest list. Kernel notifications are looked up by their
+ * name, their IDs and their type, so a notification about one connection
+ * or name does not visit the subscribers of all the others. The index is
+ * protected by the bus lock.
+ */
+struct kdbus_match_index {
+	DECLARE_HASHTABLE(ids, 6);
+	DECLARE_HASHTABLE(names, 6);
+	struct hlist_head *bloom;
+	unsigned int *bloom_count;
+	unsigned int bloom_bits;
+	struct hlist_head wildcard;
+	DECLARE_HASHTABLE(notify_types, 3);
+	DECLARE_HASHTABLE(notify_ids, 6);
+	DECLARE_HASHTABLE(notify_names, 6);
+	u64 gen;
+	struct kdbus_match_counters retired;
 };
 
 /**
@@ -41,17 +215,29 @@ struct kdbus_match_db {
  * @cookie:		User-supplied cookie to lookup the entry
  * @list_entry:		The list entry element for the db list
  * @rules_list:		The list head for tracking rules of this entry
+ * @conn:		The connection owning the match database; entries are
+ *			removed from the index before it goes away
+ * @index_node:		The entry in the bus-wide match index
+ * @bloom_bit:		The bloom bit the entry is indexed by, or -1
+ * @hits:		Number of broadcasts the entry matched first
+ * @rcu:		RCU head, the hit counter may still be used by the
+ *			readers of an old program
  */
 struct kdbus_match_entry {
 	u64			cookie;
 	struct list_head	list_entry;
 	struct list_head	rules_list;
+	struct kdbus_conn	*conn;
+	struct hlist_node	index_node;
+	int			bloom_bit;
+	atomic64_t		hits;
+	struct rcu_head		rcu;
 };
 
 /**
  * struct kdbus_match_rule - a rule appended to a match entry
  * @type:		An item type to match agains
- * @name:		Name to match against
+ * @name:		Name to match against, interned in the bus
  * @bloom:		Bloom filter to match against
  * @old_id:		For KDBUS_ITEM_ID_REMOVE and KDBUS_ITEM_NAME_REMOVE or
  *			KDBUS_ITEM_NAME_CHANGE, stores a connection ID
@@ -63,7 +249,7 @@ struct kdbus_match_entry {
 struct kdbus_match_rule {
 	u64			type;
 	union {
-		char		*name;
+		struct kdbus_name_atom *name;
 		u64		*bloom;
 	};
 	union {
@@ -86,7 +272,7 @@ static void kdbus_match_rule_free(struct kdbus_match_rule *rule)
 	case KDBUS_ITEM_NAME_ADD:
 	case KDBUS_ITEM_NAME_REMOVE:
 	case KDBUS_ITEM_NAME_CHANGE:
-		kfree(rule->name);
+		kdbus_name_atom_unref(rule->name);
 		break;
 
 	case KDBUS_ITEM_ID:
@@ -108,6 +294,375 @@ static void kdbus_match_entry_free(struct kdbus_match_entry *entry)
 
 	list_for_each_entry_safe(r, tmp, &entry->rules_list, rules_entry)
 		kdbus_match_rule_free(r);
+
+	list_del(&entry->list_entry);
+	kfree_rcu(entry, rcu);
+}
+
+/* add the values of a set of counters to another one */
+static void kdbus_match_counters_add(struct kdbus_match_counters *to,
+				     struct kdbus_match_counters *from)
+{
+	atomic64_add(atomic64_read(&from->evaluated), &to->evaluated);
+	atomic64_add(atomic64_read(&from->matched), &to->matched);
+	atomic64_add(atomic64_read(&from->bloom_checked), &to->bloom_checked);
+	atomic64_add(atomic64_read(&from->bloom_hits), &to->bloom_hits);
+}
+
+/**
+ * kdbus_match_index_new() - create a new match index
+ * @bloom_size:		The size of the bloom filter of the bus
+ * @index:		Pointer location for the returned index
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_match_index_new(size_t bloom_size, struct kdbus_match_index **index)
+{
+	struct kdbus_match_index *i;
+
+	i = kzalloc(sizeof(*i), GFP_KERNEL);
+	if (!i)
+		return -ENOMEM;
+
+	i->bloom_bits = bloom_size * 8;
+	i->bloom = kcalloc(i->bloom_bits, sizeof(struct hlist_head),
+			   GFP_KERNEL);
+	i->bloom_count = kcalloc(i->bloom_bits, sizeof(unsigned int),
+				 GFP_KERNEL);
+	if (!i->bloom || !i->bloom_count) {
+		kdbus_match_index_free(i);
+		return -ENOMEM;
+	}
+
+	hash_init(i->ids);
+	hash_init(i->names);
+	INIT_HLIST_HEAD(&i->wildcard);
+	hash_init(i->notify_types);
+	hash_init(i->notify_ids);
+	hash_init(i->notify_names);
+
+	*index = i;
+	return 0;
+}
+
+/**
+ * kdbus_match_index_free() - free match index resources
+ * @index:		The match index, may be NULL
+ *
+ * All entries must have been removed from the index.
+ */
+void kdbus_match_index_free(struct kdbus_match_index *index)
+{
+	if (!index)
+		return;
+
+	kfree(index->bloom);
+	kfree(index->bloom_count);
+	kfree(index);
+}
+
+/* find the set bit of all bloom masks of an entry with the shortest list */
+static int kdbus_match_index_bloom_bit(const struct kdbus_match_index *index,
+				       const struct kdbus_match_entry *entry)
+{
+	const struct kdbus_match_rule *r;
+	int best = -1;
+
+	list_for_each_entry(r, &entry->rules_list, rules_entry) {
+		unsigned int w;
+
+		if (r->type != KDBUS_ITEM_BLOOM)
+			continue;
+
+		for (w = 0; w < index->bloom_bits / 64; w++) {
+			u64 v = r->bloom[w];
+
+			while (v) {
+				int bit = w * 64 + __ffs64(v);
+
+				if (best < 0 ||
+				    index->bloom_count[bit] <
+				    index->bloom_count[best])
+					best = bit;
+
+				v &= v - 1;
+			}
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Post an entry with notification rules under the name it asks for, or else
+ * under one of the IDs it asks for, or else under its type.
+ */
+static void kdbus_match_index_add_notify(struct kdbus_match_index *index,
+					 struct kdbus_match_entry *entry)
+{
+	u64 type = 0, id = KDBUS_MATCH_ID_ANY;
+	const struct kdbus_match_rule *r;
+	const struct kdbus_name_atom *name = NULL;
+
+	list_for_each_entry(r, &entry->rules_list, rules_entry) {
+		switch (r->type) {
+		case KDBUS_ITEM_ID_ADD:
+			if (r->new_id != KDBUS_MATCH_ID_ANY)
+				id = r->new_id;
+			break;
+
+		case KDBUS_ITEM_ID_REMOVE:
+			if (r->old_id != KDBUS_MATCH_ID_ANY)
+				id = r->old_id;
+			break;
+
+		case KDBUS_ITEM_NAME_ADD:
+		case KDBUS_ITEM_NAME_REMOVE:
+		case KDBUS_ITEM_NAME_CHANGE:
+			if (r->name)
+				name = r->name;
+			else if (r->old_id != KDBUS_MATCH_ID_ANY)
+				id = r->old_id;
+			else if (r->new_id != KDBUS_MATCH_ID_ANY)
+				id = r->new_id;
+			break;
+
+		default:
+			/* mixed with other rules, the entry never matches */
+			continue;
+		}
+
+		if (type == 0)
+			type = r->type;
+	}
+
+	if (name)
+		hash_add(index->notify_names, &entry->index_node, name->hash);
+	else if (id != KDBUS_MATCH_ID_ANY)
+		hash_add(index->notify_ids, &entry->index_node, id);
+	else
+		hash_add(index->notify_types, &entry->index_node, type);
+}
+
+/* post an entry in the index; the caller must hold the bus lock */
+static void kdbus_match_index_add(struct kdbus_match_index *index,
+				  struct kdbus_match_entry *entry)
+{
+	const struct kdbus_match_rule *r, *id = NULL, *name = NULL;
+	int bit;
+
+	entry->bloom_bit = -1;
+
+	list_for_each_entry(r, &entry->rules_list, rules_entry) {
+		switch (r->type) {
+		case KDBUS_ITEM_BLOOM:
+			break;
+
+		case KDBUS_ITEM_ID:
+			if (!id && r->src_id != KDBUS_MATCH_ID_ANY)
+				id = r;
+			break;
+
+		case KDBUS_ITEM_NAME:
+			if (!name)
+				name = r;
+			break;
+
+		default:
+			/* only kernel notifications can match */
+			kdbus_match_index_add_notify(index, entry);
+			return;
+		}
+	}
+
+	if (id) {
+		hash_add(index->ids, &entry->index_node, id->src_id);
+		return;
+	}
+
+	if (name) {
+		hash_add(index->names, &entry->index_node, name->name->hash);
+		return;
+	}
+
+	bit = kdbus_match_index_bloom_bit(index, entry);
+	if (bit >= 0) {
+		hlist_add_head(&entry->index_node, &index->bloom[bit]);
+		index->bloom_count[bit]++;
+		entry->bloom_bit = bit;
+		return;
+	}
+
+	hlist_add_head(&entry->index_node, &index->wildcard);
+}
+
+/* remove an entry from the index; the caller must hold the bus lock */
+static void kdbus_match_index_del(struct kdbus_match_index *index,
+				  struct kdbus_match_entry *entry)
+{
+	if (hlist_unhashed(&entry->index_node))
+		return;
+
+	hlist_del_init(&entry->index_node);
+
+	if (entry->bloom_bit >= 0)
+		index->bloom_count[entry->bloom_bit]--;
+}
+
+/* add the owner of an entry to the candidates, unless it already is */
+static void kdbus_match_index_collect(struct kdbus_match_index *index,
+				      struct kdbus_match_entry *entry,
+				      struct list_head *list)
+{
+	struct kdbus_conn *conn = entry->conn;
+
+	if (conn->match_gen == index->gen)
+		return;
+
+	conn->match_gen = index->gen;
+	list_add_tail(&conn->match_entry, list);
+}
+
+/* collect the owners of the entries which can match a kernel notification */
+static void kdbus_match_index_collect_notify(struct kdbus_match_index *index,
+					     const struct kdbus_kmsg *kmsg,
+					     struct list_head *list)
+{
+	struct kdbus_match_entry *entry;
+
+	hash_for_each_possible(index->notify_types, entry, index_node,
+			       kmsg->notify_type)
+		kdbus_match_index_collect(index, entry, list);
+
+	hash_for_each_possible(index->notify_ids, entry, index_node,
+			       kmsg->notify_old_id)
+		kdbus_match_index_collect(index, entry, list);
+
+	if (kmsg->notify_new_id != kmsg->notify_old_id)
+		hash_for_each_possible(index->notify_ids, entry, index_node,
+				       kmsg->notify_new_id)
+			kdbus_match_index_collect(index, entry, list);
+
+	if (kmsg->notify_name)
+		hash_for_each_possible(index->notify_names, entry, index_node,
+				       kmsg->notify_name->hash)
+			kdbus_match_index_collect(index, entry, list);
+}
+
+/**
+ * kdbus_match_index_candidates() - find the possible receivers of a broadcast
+ * @index:		The match index of the bus
+ * @conn_src:		The sending connection, NULL for kernel notifications
+ * @kmsg:		The message to broadcast
+ * @list:		List to add the candidate connections to, linked by
+ *			their match_entry member
+ *
+ * Only the connections which own an entry posted under one of the keys of
+ * the message are collected, every connection at most once. The candidates
+ * still need to be checked with kdbus_match_db_match_kmsg(). The caller must
+ * hold the bus lock, and must remove all connections from @list before
+ * releasing it.
+ */
+void kdbus_match_index_candidates(struct kdbus_match_index *index,
+				  struct kdbus_conn *conn_src,
+				  const struct kdbus_kmsg *kmsg,
+				  struct list_head *list)
+{
+	struct kdbus_match_entry *entry;
+
+	index->gen++;
+
+	hlist_for_each_entry(entry, &index->wildcard, index_node)
+		kdbus_match_index_collect(index, entry, list);
+
+	if (!conn_src) {
+		kdbus_match_index_collect_notify(index, kmsg, list);
+		return;
+	}
+
+	hash_for_each_possible(index->ids, entry, index_node, conn_src->id)
+		kdbus_match_index_collect(index, entry, list);
+
+	if (!hash_empty(index->names)) {
+		struct kdbus_name_entry *e;
+
+		mutex_lock(&conn_src->lock);
+		list_for_each_entry(e, &conn_src->names_list, conn_entry)
+			hash_for_each_possible(index->names, entry, index_node,
+					       e->atom->hash)
+				kdbus_match_index_collect(index, entry, list);
+		mutex_unlock(&conn_src->lock);
+	}
+
+	if (kmsg->bloom) {
+		unsigned int w;
+
+		for (w = 0; w < index->bloom_bits / 64; w++) {
+			u64 v = kmsg->bloom[w];
+
+			while (v) {
+				unsigned int bit = w * 64 + __ffs64(v);
+
+				hlist_for_each_entry(entry, &index->bloom[bit],
+						     index_node)
+					kdbus_match_index_collect(index, entry,
+								  list);
+
+				v &= v - 1;
+			}
+		}
+	}
+}
+
+/**
+ * kdbus_match_index_candidates_notify() - find the possible receivers of a
+ *					   list of kernel notifications
+ * @index:		The match index of the bus
+ * @kmsg_list:		List of broadcast kernel notifications, linked by
+ *			their queue_entry member
+ * @list:		List to add the candidate connections to, linked by
+ *			their match_entry member
+ *
+ * Like kdbus_match_index_candidates(), but collects every connection only
+ * once for all the notifications of @kmsg_list. The caller must hold the bus
+ * lock, and must remove all connections from @list before releasing it.
+ */
+void kdbus_match_index_candidates_notify(struct kdbus_match_index *index,
+					 const struct list_head *kmsg_list,
+					 struct list_head *list)
+{
+	struct kdbus_match_entry *entry;
+	const struct kdbus_kmsg *kmsg;
+
+	index->gen++;
+
+	hlist_for_each_entry(entry, &index->wildcard, index_node)
+		kdbus_match_index_collect(index, entry, list);
+
+	list_for_each_entry(kmsg, kmsg_list, queue_entry)
+		kdbus_match_index_collect_notify(index, kmsg, list);
+}
+
+/**
+ * kdbus_match_db_unindex() - remove all entries of a database from the index
+ * @db:			The match database
+ * @index:		The match index of the bus
+ *
+ * Called when the owning connection is disconnected; the caller must hold
+ * the bus lock. The counters of the database are added to the totals of
+ * the bus.
+ */
+void kdbus_match_db_unindex(struct kdbus_match_db *db,
+			    struct kdbus_match_index *index)
+{
+	struct kdbus_match_entry *entry;
+
+	mutex_lock(&db->entries_lock);
+	list_for_each_entry(entry, &db->entries_list, list_entry)
+		kdbus_match_index_del(index, entry);
+	mutex_unlock(&db->entries_lock);
+
+	kdbus_match_counters_add(&index->retired, &db->counters);
 }
 
 /**
@@ -123,6 +678,8 @@ void kdbus_match_db_free(struct kdbus_match_db *db)
 		kdbus_match_entry_free(entry);
 	mutex_unlock(&db->entries_lock);
 
+	/* the connection is gone, nobody can run the program anymore */
+	kfree(rcu_access_pointer(db->prog));
 	kfree(db);
 }
 
@@ -147,98 +704,441 @@ int kdbus_match_db_new(struct kdbus_match_db **db)
 	return 0;
 }
 
-static bool kdbus_match_bloom(const u64 *filter, const u64 *mask,
-		       const struct kdbus_conn *conn)
+/* fold a notification rule into the prototype of its entry */
+static bool kdbus_match_prog_notify_add(struct kdbus_match_prog_notify *n,
+					const struct kdbus_match_rule *r)
 {
-	unsigned int i;
+	u64 old_id = r->old_id;
+	u64 new_id = r->new_id;
+
+	/* a notification has only one type */
+	if (n->type != 0 && n->type != r->type)
+		return false;
+
+	n->type = r->type;
+
+	if (r->type == KDBUS_ITEM_ID_ADD)
+		old_id = KDBUS_MATCH_ID_ANY;
+	else if (r->type == KDBUS_ITEM_ID_REMOVE)
+		new_id = KDBUS_MATCH_ID_ANY;
+
+	if (old_id != KDBUS_MATCH_ID_ANY) {
+		if (n->old_id != KDBUS_MATCH_ID_ANY && n->old_id != old_id)
+			return false;
+
+		n->old_id = old_id;
+	}
 
-	for (i = 0; i < conn->ep->bus->bloom_size / sizeof(u64); i++)
-		if ((filter[i] & mask[i]) != mask[i])
+	if (new_id != KDBUS_MATCH_ID_ANY) {
+		if (n->new_id != KDBUS_MATCH_ID_ANY && n->new_id != new_id)
 			return false;
 
+		n->new_id = new_id;
+	}
+
+	if (r->name) {
+		if (n->name && n->name != r->name)
+			return false;
+
+		n->name = r->name;
+	}
+
 	return true;
 }
 
-static bool kdbus_match_rules(const struct kdbus_match_entry *entry,
-			      struct kdbus_conn *conn_src,
-			      struct kdbus_kmsg *kmsg)
+/* compile one entry into the program, its bloom mask goes to @masks */
+static void kdbus_match_prog_add(struct kdbus_match_prog *prog, u64 *masks,
+				 struct kdbus_match_entry *entry)
 {
-	struct kdbus_match_rule *r;
+	struct kdbus_match_prog_notify *n = prog->notify + prog->n_notify;
+	struct kdbus_match_prog_entry *e = prog->entries + prog->n_entries;
+	u64 *mask = masks + prog->n_entries * prog->bloom_words;
+	const struct kdbus_match_rule *r;
+	bool user = true, kernel = true;
+	unsigned int i;
 
-	/*
-	 * Walk all the rules and bail out immediately
-	 * if any of them is unsatisfied.
-	 */
+	e->src_id = KDBUS_MATCH_ID_ANY;
+	e->slot = prog->n_entries;
+	e->names = prog->n_names;
+	e->n_names = 0;
+	e->hits = &entry->hits;
+	memset(mask, 0, prog->bloom_words * sizeof(u64));
+
+	n->type = 0;
+	n->old_id = KDBUS_MATCH_ID_ANY;
+	n->new_id = KDBUS_MATCH_ID_ANY;
+	n->name = NULL;
+	n->hits = &entry->hits;
 
 	list_for_each_entry(r, &entry->rules_list, rules_entry) {
+		switch (r->type) {
+		case KDBUS_ITEM_BLOOM:
+			kernel = false;
 
-		if (conn_src == NULL) {
-			/* kernel notifications */
+			for (i = 0; i < prog->bloom_words; i++)
+				mask[i] |= r->bloom[i];
 
-			if (kmsg->notify_type != r->type)
-				return false;
+			break;
 
-			switch (r->type) {
-			case KDBUS_ITEM_ID_ADD:
-				if (r->new_id != KDBUS_MATCH_ID_ANY &&
-				    r->new_id != kmsg->notify_new_id)
-					return false;
+		case KDBUS_ITEM_ID:
+			kernel = false;
 
+			if (r->src_id == KDBUS_MATCH_ID_ANY)
 				break;
 
-			case KDBUS_ITEM_ID_REMOVE:
-				if (r->old_id != KDBUS_MATCH_ID_ANY &&
-				    r->old_id != kmsg->notify_old_id)
-					return false;
+			if (e->src_id != KDBUS_MATCH_ID_ANY &&
+			    e->src_id != r->src_id)
+				user = false;
 
-				break;
+			e->src_id = r->src_id;
+			break;
 
-			case KDBUS_ITEM_NAME_ADD:
-			case KDBUS_ITEM_NAME_CHANGE:
-			case KDBUS_ITEM_NAME_REMOVE:
-				if ((r->old_id != KDBUS_MATCH_ID_ANY &&
-				     r->old_id != kmsg->notify_old_id) ||
-				    (r->new_id != KDBUS_MATCH_ID_ANY &&
-				     r->new_id != kmsg->notify_new_id) ||
-				    (r->name && kmsg->notify_name &&
-				     strcmp(r->name, kmsg->notify_name) != 0))
-					return false;
+		case KDBUS_ITEM_NAME:
+			kernel = false;
+			prog->names[e->names + e->n_names++] = r->name;
+			break;
 
-				break;
+		default:
+			user = false;
 
-			default:
-				return false;
-			}
-		} else {
-			/* messages from userspace */
+			if (!kdbus_match_prog_notify_add(n, r))
+				kernel = false;
 
-			switch (r->type) {
-			case KDBUS_ITEM_BLOOM:
-				if (!kdbus_match_bloom(kmsg->bloom,
-						       r->bloom, conn_src))
-					return false;
-				break;
+			break;
+		}
+	}
 
-			case KDBUS_ITEM_ID:
-				if (r->src_id != conn_src->id &&
-				    r->src_id != KDBUS_MATCH_ID_ANY)
-					return false;
+	if (user) {
+		prog->n_entries++;
+		prog->n_names += e->n_names;
+	}
 
-				break;
+	if (kernel)
+		prog->n_notify++;
+}
 
-			case KDBUS_ITEM_NAME:
-				if (!kdbus_conn_has_name(conn_src, r->name))
-					return false;
+static int kdbus_match_prog_cmp(const void *a, const void *b)
+{
+	const struct kdbus_match_prog_entry *ea = a;
+	const struct kdbus_match_prog_entry *eb = b;
 
+	if (ea->src_id < eb->src_id)
+		return -1;
+
+	return ea->src_id > eb->src_id;
+}
+
+/*
+ * Compile all entries of a database into a new program, and publish it
+ * in place of the current one; the caller must hold the entries lock.
+ */
+static int kdbus_match_db_compile(struct kdbus_match_db *db,
+				  size_t bloom_size)
+{
+	unsigned int bloom_words = bloom_size / sizeof(u64);
+	unsigned int n_entries = 0, n_names = 0;
+	struct kdbus_match_prog *prog, *old;
+	struct kdbus_match_entry *entry;
+	size_t size;
+	unsigned int i;
+	u64 *masks;
+	void *p;
+
+	/* count the records, including the ones of contradicting entries */
+	list_for_each_entry(entry, &db->entries_list, list_entry) {
+		const struct kdbus_match_rule *r;
+
+		n_entries++;
+
+		list_for_each_entry(r, &entry->rules_list, rules_entry)
+			if (r->type == KDBUS_ITEM_NAME)
+				n_names++;
+	}
+
+	size = sizeof(*prog) +
+	       n_entries * sizeof(struct kdbus_match_prog_entry) +
+	       n_entries * sizeof(struct kdbus_match_prog_notify) +
+	       n_names * sizeof(struct kdbus_name_atom *) +
+	       n_entries * bloom_size;
+
+	prog = kmalloc(size, GFP_KERNEL);
+	if (!prog)
+		return -ENOMEM;
+
+	/* the masks in the order of the list, until the entries are sorted */
+	masks = kmalloc_array(n_entries, bloom_size, GFP_KERNEL);
+	if (!masks) {
+		kfree(prog);
+		return -ENOMEM;
+	}
+
+	p = prog + 1;
+	prog->entries = p;
+	p += n_entries * sizeof(struct kdbus_match_prog_entry);
+	prog->notify = p;
+	p += n_entries * sizeof(struct kdbus_match_prog_notify);
+	prog->names = p;
+	p += n_names * sizeof(struct kdbus_name_atom *);
+	prog->blooms = p;
+
+	prog->n_entries = 0;
+	prog->n_notify = 0;
+	prog->n_names = 0;
+	prog->bloom_words = bloom_words;
+
+	list_for_each_entry(entry, &db->entries_list, list_entry)
+		kdbus_match_prog_add(prog, masks, entry);
+
+	sort(prog->entries, prog->n_entries,
+	     sizeof(struct kdbus_match_prog_entry),
+	     kdbus_match_prog_cmp, NULL);
+
+	for (i = 0; i < prog->n_entries; i++)
+		memcpy(prog->blooms + i * bloom_words,
+		       masks + prog->entries[i].slot * bloom_words,
+		       bloom_size);
+
+	kfree(masks);
+
+	for (i = 0; i < prog->n_entries; i++)
+		if (prog->entries[i].src_id == KDBUS_MATCH_ID_ANY)
+			break;
+
+	prog->n_ids = i;
+
+	old = rcu_dereference_protected(db->prog,
+					lockdep_is_held(&db->entries_lock));
+	rcu_assign_pointer(db->prog, prog);
+	if (old)
+		kfree_rcu(old, rcu);
+
+	return 0;
+}
+
+/* check one bloom mask against a filter */
+static __always_inline bool kdbus_match_bloom1(const u64 *filter,
+					       const u64 *mask,
+					       unsigned int words)
+{
+	u64 miss = 0;
+	unsigned int i;
+
+	for (i = 0; i < words; i++)
+		miss |= mask[i] & ~filter[i];
+
+	return miss == 0;
+}
+
+/*
+ * Check four bloom masks, stored back to back, against a filter in one
+ * pass, loading every word of the filter only once. Bit n of the returned
+ * value is set if mask n matches.
+ */
+static __always_inline unsigned long kdbus_match_bloom4(const u64 *filter,
+							const u64 *masks,
+							unsigned int words)
+{
+	u64 miss0 = 0, miss1 = 0, miss2 = 0, miss3 = 0;
+	unsigned int i;
+
+	for (i = 0; i < words; i++) {
+		u64 f = ~filter[i];
+
+		miss0 |= masks[i] & f;
+		miss1 |= masks[words + i] & f;
+		miss2 |= masks[2 * words + i] & f;
+		miss3 |= masks[3 * words + i] & f;
+	}
+
+	return (miss0 == 0) | ((miss1 == 0) << 1) |
+	       ((miss2 == 0) << 2) | ((miss3 == 0) << 3);
+}
+
+/*
+ * The bloom size is fixed per bus, and almost always one of 64, 128, 256
+ * or 512 bytes; pass those as constants, so the compiler can unroll the
+ * loops over the words.
+ */
+static bool kdbus_match_bloom(const u64 *filter, const u64 *mask,
+			      unsigned int words)
+{
+	switch (words) {
+	case 8:
+		return kdbus_match_bloom1(filter, mask, 8);
+	case 16:
+		return kdbus_match_bloom1(filter, mask, 16);
+	case 32:
+		return kdbus_match_bloom1(filter, mask, 32);
+	case 64:
+		return kdbus_match_bloom1(filter, mask, 64);
+	default:
+		return kdbus_match_bloom1(filter, mask, words);
+	}
+}
+
+static unsigned long kdbus_match_bloom_multi(const u64 *filter,
+					     const u64 *masks,
+					     unsigned int words)
+{
+	switch (words) {
+	case 8:
+		return kdbus_match_bloom4(filter, masks, 8);
+	case 16:
+		return kdbus_match_bloom4(filter, masks, 16);
+	case 32:
+		return kdbus_match_bloom4(filter, masks, 32);
+	case 64:
+		return kdbus_match_bloom4(filter, masks, 64);
+	default:
+		return kdbus_match_bloom4(filter, masks, words);
+	}
+}
+
+/*
+ * Check if the sender owns all names of an entry. This needs the lock of
+ * the sender, which cannot be taken under rcu_read_lock(); without it,
+ * entries with names are only recorded as deferred.
+ */
+static bool kdbus_match_names(const struct kdbus_match_prog *prog,
+			      const struct kdbus_match_prog_entry *e,
+			      struct kdbus_match_ctx *ctx)
+{
+	bool match = true;
+	unsigned int i;
+
+	if (e->n_names == 0)
+		return true;
+
+	if (!ctx->names) {
+		ctx->deferred = true;
+		return false;
+	}
+
+	for (i = 0; i < e->n_names && match; i++) {
+		const struct kdbus_name_atom *n = prog->names[e->names + i];
+		struct kdbus_name_entry *ne;
+
+		match = false;
+		list_for_each_entry(ne, &ctx->conn_src->names_list,
+				    conn_entry) {
+			if (ne->atom == n) {
+				match = true;
 				break;
+			}
+		}
+	}
+
+	return match;
+}
+
+/* run the entries from @first to @last of a program */
+static bool kdbus_match_prog_range(const struct kdbus_match_prog *prog,
+				   unsigned int first, unsigned int last,
+				   struct kdbus_match_ctx *ctx)
+{
+	const u64 *filter = ctx->kmsg->bloom;
+	const unsigned int words = prog->bloom_words;
+	unsigned int i = first;
+
+	for (; i + 4 <= last; i += 4) {
+		unsigned long hits;
+
+		hits = kdbus_match_bloom_multi(filter,
+					       prog->blooms + i * words, words);
+		ctx->bloom_checked += 4;
+		ctx->bloom_hits += hweight_long(hits);
+
+		while (hits) {
+			unsigned int k = __ffs(hits);
 
-			default:
-				return false;
+			if (kdbus_match_names(prog, prog->entries + i + k,
+					      ctx)) {
+				atomic64_inc(prog->entries[i + k].hits);
+				return true;
 			}
+
+			hits &= hits - 1;
 		}
 	}
 
-	return true;
+	for (; i < last; i++) {
+		ctx->bloom_checked++;
+
+		if (!kdbus_match_bloom(filter, prog->blooms + i * words, words))
+			continue;
+
+		ctx->bloom_hits++;
+
+		if (kdbus_match_names(prog, prog->entries + i, ctx)) {
+			atomic64_inc(prog->entries[i].hits);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool kdbus_match_prog_kmsg(const struct kdbus_match_prog *prog,
+				  struct kdbus_match_ctx *ctx)
+{
+	unsigned int lo = 0, hi = prog->n_ids, i;
+	u64 src_id = ctx->conn_src->id;
+
+	/* the first entry asking for the sender's ID */
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (prog->entries[mid].src_id < src_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* ... and the first one after it asking for another ID */
+	for (i = lo; i < prog->n_ids; i++)
+		if (prog->entries[i].src_id != src_id)
+			break;
+
+	if (kdbus_match_prog_range(prog, lo, i, ctx))
+		return true;
+
+	return kdbus_match_prog_range(prog, prog->n_ids, prog->n_entries, ctx);
+}
+
+static bool kdbus_match_prog_notify(const struct kdbus_match_prog *prog,
+				    const struct kdbus_kmsg *kmsg)
+{
+	unsigned int i;
+
+	for (i = 0; i < prog->n_notify; i++) {
+		const struct kdbus_match_prog_notify *n = prog->notify + i;
+
+		/* an entry without rules matches everything */
+		if (n->type == 0) {
+			atomic64_inc(n->hits);
+			return true;
+		}
+
+		if (n->type != kmsg->notify_type)
+			continue;
+
+		if (n->old_id != KDBUS_MATCH_ID_ANY &&
+		    n->old_id != kmsg->notify_old_id)
+			continue;
+
+		if (n->new_id != KDBUS_MATCH_ID_ANY &&
+		    n->new_id != kmsg->notify_new_id)
+			continue;
+
+		if (n->name && kmsg->notify_name &&
+		    n->name != kmsg->notify_name)
+			continue;
+
+		atomic64_inc(n->hits);
+		return true;
+	}
+
+	return false;
 }
 
 /**
@@ -247,9 +1147,15 @@ static bool kdbus_match_rules(const struct kdbus_match_entry *entry,
  * @conn_src:		The connection object originating the message
  * @kmsg:		The kmsg to perform the match on
  *
- * This function will walk through all the database entries previously uploaded
- * with kdbus_match_db_add(). As soon as any of them has an all-satisfied rule
- * set, this function will return true.
+ * This function will run the program compiled from all the database entries
+ * previously uploaded with kdbus_match_db_add(). As soon as any of them has
+ * an all-satisfied rule set, this function will return true.
+ *
+ * The program is run under rcu_read_lock(), without taking any lock of the
+ * database. Only if the result depends on the names of the sender, the
+ * program is run a second time with the lock of the sender held. The
+ * counters of the database are updated once per call, the bloom masks of
+ * the second run are not counted again.
  *
  * Return: true if there was a matching database entry, false otherwise.
  */
@@ -257,16 +1163,43 @@ bool kdbus_match_db_match_kmsg(struct kdbus_match_db *db,
 			       struct kdbus_conn *conn_src,
 			       struct kdbus_kmsg *kmsg)
 {
-	struct kdbus_match_entry *entry;
+	struct kdbus_match_ctx ctx = {
+		.conn_src = conn_src,
+		.kmsg = kmsg,
+	};
+	const struct kdbus_match_prog *prog;
 	bool matched = false;
 
-	mutex_lock(&db->entries_lock);
-	list_for_each_entry(entry, &db->entries_list, list_entry) {
-		matched = kdbus_match_rules(entry, conn_src, kmsg);
-		if (matched)
-			break;
+	rcu_read_lock();
+	prog = rcu_dereference(db->prog);
+	if (prog) {
+		if (conn_src)
+			matched = kdbus_match_prog_kmsg(prog, &ctx);
+		else
+			matched = kdbus_match_prog_notify(prog, kmsg);
+	}
+	rcu_read_unlock();
+
+	atomic64_inc(&db->counters.evaluated);
+	if (ctx.bloom_checked > 0) {
+		atomic64_add(ctx.bloom_checked, &db->counters.bloom_checked);
+		atomic64_add(ctx.bloom_hits, &db->counters.bloom_hits);
 	}
-	mutex_unlock(&db->entries_lock);
+
+	if (!matched && ctx.deferred) {
+		mutex_lock(&conn_src->lock);
+		rcu_read_lock();
+		prog = rcu_dereference(db->prog);
+		if (prog) {
+			ctx.names = true;
+			matched = kdbus_match_prog_kmsg(prog, &ctx);
+		}
+		rcu_read_unlock();
+		mutex_unlock(&conn_src->lock);
+	}
+
+	if (matched)
+		atomic64_inc(&db->counters.matched);
 
 	return matched;
 }
@@ -341,6 +1274,7 @@ static int cmd_match_from_user(const struct kdbus_conn *conn,
  */
 int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 {
+	struct kdbus_bus *bus = conn->ep->bus;
 	struct kdbus_conn *target_conn = NULL;
 	struct kdbus_match_entry *entry = NULL;
 	struct kdbus_cmd_match *cmd_match;
@@ -354,13 +1288,8 @@ int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 		return ret;
 
 	if (cmd_match->owner_id != 0 && cmd_match->owner_id != conn->id) {
-		struct kdbus_bus *bus = conn->ep->bus;
-
-		mutex_lock(&bus->lock);
 		target_conn = kdbus_bus_find_conn_by_id(bus,
 							cmd_match->owner_id);
-		mutex_unlock(&bus->lock);
-
 		if (!target_conn) {
 			ret = -ENXIO;
 			goto exit_free;
@@ -379,7 +1308,9 @@ int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 
 	entry->cookie = cmd_match->cookie;
 
+	INIT_LIST_HEAD(&entry->list_entry);
 	INIT_LIST_HEAD(&entry->rules_list);
+	INIT_HLIST_NODE(&entry->index_node);
 
 	KDBUS_ITEM_FOREACH(item, cmd_match, items) {
 		struct kdbus_match_rule *rule;
@@ -400,7 +1331,7 @@ int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 
 		switch (item->type) {
 		case KDBUS_ITEM_BLOOM:
-			if (size != conn->ep->bus->bloom_size) {
+			if (size != bus->bloom_size) {
 				ret = -EBADMSG;
 				break;
 			}
@@ -419,9 +1350,8 @@ int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 				break;
 			}
 
-			rule->name = kstrdup(item->str, GFP_KERNEL);
-			if (!rule->name)
-				ret = -ENOMEM;
+			ret = kdbus_name_atom_get(bus->name_registry,
+						  item->str, &rule->name);
 
 			break;
 
@@ -445,12 +1375,10 @@ int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 			rule->old_id = item->name_change.old.id;
 			rule->new_id = item->name_change.new.id;
 
-			if (size > sizeof(struct kdbus_notify_name_change)) {
-				rule->name = kstrdup(item->name_change.name,
-						     GFP_KERNEL);
-				if (!rule->name)
-					ret = -ENOMEM;
-			}
+			if (size > sizeof(struct kdbus_notify_name_change))
+				ret = kdbus_name_atom_get(bus->name_registry,
+						item->name_change.name,
+						&rule->name);
 
 			break;
 		}
@@ -483,9 +1411,27 @@ int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf)
 	if (ret == 0 && !KDBUS_ITEM_END(item, cmd_match))
 		ret = -EINVAL;
 
-	if (ret == 0)
-		list_add_tail(&entry->list_entry, &db->entries_list);
-	else
+	if (ret == 0) {
+		entry->conn = target_conn ? target_conn : conn;
+
+		mutex_lock(&bus->lock);
+		if (ACCESS_ONCE(entry->conn->disconnected)) {
+			ret = -ECONNRESET;
+		} else {
+			mutex_lock(&db->entries_lock);
+			list_add_tail(&entry->list_entry, &db->entries_list);
+			ret = kdbus_match_db_compile(db, bus->bloom_size);
+			if (ret < 0)
+				list_del_init(&entry->list_entry);
+			mutex_unlock(&db->entries_lock);
+
+			if (ret == 0)
+				kdbus_match_index_add(bus->match_index, entry);
+		}
+		mutex_unlock(&bus->lock);
+	}
+
+	if (ret < 0)
 		kdbus_match_entry_free(entry);
 
 exit_free:
@@ -507,10 +1453,12 @@ exit_free:
  */
 int kdbus_match_db_remove(struct kdbus_conn *conn, void __user *buf)
 {
+	struct kdbus_bus *bus = conn->ep->bus;
 	struct kdbus_conn *target_conn = NULL;
 	struct kdbus_match_db *db;
 	struct kdbus_cmd_match *cmd_match = NULL;
 	struct kdbus_match_entry *entry, *tmp;
+	LIST_HEAD(list);
 	int ret;
 
 	ret = cmd_match_from_user(conn, buf, false, &cmd_match);
@@ -518,13 +1466,8 @@ int kdbus_match_db_remove(struct kdbus_conn *conn, void __user *buf)
 		return ret;
 
 	if (cmd_match->owner_id != 0 && cmd_match->owner_id != conn->id) {
-		struct kdbus_bus *bus = conn->ep->bus;
-
-		mutex_lock(&bus->lock);
 		target_conn = kdbus_bus_find_conn_by_id(bus,
 							cmd_match->owner_id);
-		mutex_unlock(&bus->lock);
-
 		if (!target_conn) {
 			kfree(cmd_match);
 			return -ENXIO;
@@ -535,14 +1478,165 @@ int kdbus_match_db_remove(struct kdbus_conn *conn, void __user *buf)
 		db = conn->match_db;
 	}
 
+	mutex_lock(&bus->lock);
 	mutex_lock(&db->entries_lock);
 	list_for_each_entry_safe(entry, tmp, &db->entries_list, list_entry)
 		if (entry->cookie == cmd_match->cookie)
+			list_move_tail(&entry->list_entry, &list);
+
+	/* keep the entries if the program cannot be rebuilt without them */
+	ret = kdbus_match_db_compile(db, bus->bloom_size);
+	if (ret < 0) {
+		list_splice_tail(&list, &db->entries_list);
+	} else {
+		list_for_each_entry_safe(entry, tmp, &list, list_entry) {
+			kdbus_match_index_del(bus->match_index, entry);
 			kdbus_match_entry_free(entry);
+		}
+	}
 	mutex_unlock(&db->entries_lock);
+	mutex_unlock(&bus->lock);
 
 	kdbus_conn_unref(target_conn);
 	kfree(cmd_match);
 
+	return ret;
+}
+
+/* add the counters of a database or the bus to a query result */
+static void kdbus_match_counters_read(struct kdbus_match_stats *stats,
+				      struct kdbus_match_counters *c)
+{
+	stats->evaluated += atomic64_read(&c->evaluated);
+	stats->matched += atomic64_read(&c->matched);
+	stats->bloom_checked += atomic64_read(&c->bloom_checked);
+	stats->bloom_hits += atomic64_read(&c->bloom_hits);
+}
+
+/* the counters of one database, with the hits of all its entries */
+static int kdbus_match_db_stats(struct kdbus_match_db *db,
+				struct kdbus_match_stats **stats)
+{
+	struct kdbus_match_entry *entry;
+	struct kdbus_match_stats *s;
+	unsigned int n = 0;
+	size_t size;
+
+	mutex_lock(&db->entries_lock);
+	list_for_each_entry(entry, &db->entries_list, list_entry)
+		n++;
+
+	size = sizeof(*s) + n * sizeof(struct kdbus_match_entry_stats);
+	s = kzalloc(size, GFP_KERNEL);
+	if (!s) {
+		mutex_unlock(&db->entries_lock);
+		return -ENOMEM;
+	}
+
+	n = 0;
+	list_for_each_entry(entry, &db->entries_list, list_entry) {
+		s->entries[n].cookie = entry->cookie;
+		s->entries[n].hits = atomic64_read(&entry->hits);
+		n++;
+	}
+	mutex_unlock(&db->entries_lock);
+
+	kdbus_match_counters_read(s, &db->counters);
+	s->size = size;
+
+	*stats = s;
 	return 0;
 }
+
+/* the totals of all databases on the bus, and of the ones already gone */
+static int kdbus_match_bus_stats(struct kdbus_bus *bus,
+				 struct kdbus_match_stats **stats)
+{
+	struct kdbus_match_stats *s;
+	struct kdbus_conn *c;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	mutex_lock(&bus->lock);
+	kdbus_match_counters_read(s, &bus->match_index->retired);
+	list_for_each_entry(c, &bus->conn_list, bus_entry)
+		kdbus_match_counters_read(s, &c->match_db->counters);
+	mutex_unlock(&bus->lock);
+
+	s->size = sizeof(*s);
+
+	*stats = s;
+	return 0;
+}
+
+/**
+ * kdbus_cmd_match_stats() - retrieve the counters of a match database
+ * @conn:		The connection that was used in the ioctl call
+ * @buf:		The __user buffer that was provided by the ioctl call
+ *
+ * This function is used in the context of the KDBUS_CMD_MATCH_STATS
+ * ioctl interface. The counters are written to the pool of @conn, as a
+ * struct kdbus_match_stats.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_cmd_match_stats(struct kdbus_conn *conn, void __user *buf)
+{
+	struct kdbus_bus *bus = conn->ep->bus;
+	struct kdbus_conn *target_conn = NULL;
+	struct kdbus_cmd_match_stats cmd;
+	struct kdbus_match_stats *stats = NULL;
+	size_t off;
+	int ret;
+
+	if (copy_from_user(&cmd, buf, sizeof(cmd)))
+		return -EFAULT;
+
+	if (cmd.size != sizeof(cmd))
+		return -EINVAL;
+
+	if (cmd.flags & ~KDBUS_MATCH_STATS_BUS)
+		return -EOPNOTSUPP;
+
+	if (cmd.flags & KDBUS_MATCH_STATS_BUS) {
+		ret = kdbus_match_bus_stats(bus, &stats);
+	} else if (cmd.owner_id != 0 && cmd.owner_id != conn->id) {
+		/* privileged users can look at someone else's matches */
+		if (!kdbus_bus_uid_is_privileged(bus))
+			return -EPERM;
+
+		target_conn = kdbus_bus_find_conn_by_id(bus, cmd.owner_id);
+		if (!target_conn)
+			return -ENXIO;
+
+		ret = kdbus_match_db_stats(target_conn->match_db, &stats);
+	} else {
+		ret = kdbus_match_db_stats(conn->match_db, &stats);
+	}
+
+	if (ret < 0)
+		goto exit;
+
+	ret = kdbus_pool_alloc_range(conn->pool, stats->size, &off);
+	if (ret < 0)
+		goto exit;
+
+	ret = kdbus_pool_write(conn->pool, off, stats, stats->size);
+	if (ret < 0)
+		goto exit_free;
+
+	if (kdbus_offset_set_user(&off, buf, struct kdbus_cmd_match_stats))
+		ret = -EFAULT;
+
+exit_free:
+	if (ret < 0)
+		kdbus_pool_free_range(conn->pool, off);
+
+exit:
+	kdbus_conn_unref(target_conn);
+	kfree(stats);
+
+	return ret;
+}
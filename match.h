@@ -16,12 +16,27 @@
 struct kdbus_conn;
 struct kdbus_kmsg;
 struct kdbus_match_db;
+struct kdbus_match_index;
+
+int kdbus_match_index_new(size_t bloom_size,
+			  struct kdbus_match_index **index);
+void kdbus_match_index_free(struct kdbus_match_index *index);
+void kdbus_match_index_candidates(struct kdbus_match_index *index,
+				  struct kdbus_conn *conn_src,
+				  const struct kdbus_kmsg *kmsg,
+				  struct list_head *list);
+void kdbus_match_index_candidates_notify(struct kdbus_match_index *index,
+					 const struct list_head *kmsg_list,
+					 struct list_head *list);
 
 int kdbus_match_db_new(struct kdbus_match_db **db);
 void kdbus_match_db_free(struct kdbus_match_db *db);
 int kdbus_match_db_add(struct kdbus_conn *conn, void __user *buf);
 int kdbus_match_db_remove(struct kdbus_conn *conn, void __user *buf);
+void kdbus_match_db_unindex(struct kdbus_match_db *db,
+			    struct kdbus_match_index *index);
 bool kdbus_match_db_match_kmsg(struct kdbus_match_db *db,
 			       struct kdbus_conn *conn_src,
 			       struct kdbus_kmsg *kmsg);
+int kdbus_cmd_match_stats(struct kdbus_conn *conn, void __user *buf);
 #endif
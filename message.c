@@ -16,13 +16,16 @@
 #include <linux/device.h>
 #include <linux/file.h>
 #include <linux/init.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 
+#include "arena.h"
 #include "bus.h"
 #include "namespace.h"
 #include "connection.h"
@@ -34,6 +37,14 @@
 
 #define KDBUS_KMSG_HEADER_SIZE offsetof(struct kdbus_kmsg, msg)
 
+static void kdbus_kmsg_vecs_free(void *vecs)
+{
+	if (is_vmalloc_addr(vecs))
+		vfree(vecs);
+	else
+		kfree(vecs);
+}
+
 /**
  * kdbus_kmsg_free() - free allocated message
  * @kmsg:		Message
@@ -41,9 +52,67 @@
 void kdbus_kmsg_free(struct kdbus_kmsg *kmsg)
 {
 	kdbus_meta_free(kmsg->meta);
+	kdbus_name_atom_unref(kmsg->notify_name);
+	kdbus_kmsg_vecs_free(kmsg->vecs);
+	kdbus_arena_slice_unref(kmsg->arena_slice);
 	kfree(kmsg);
 }
 
+/**
+ * kdbus_kmsg_vecs_stage() - copy the PAYLOAD_VEC data of a message
+ * @kmsg:		Message from userspace
+ *
+ * Copy the data of all PAYLOAD_VEC items from the sender into one kernel
+ * buffer, with the same layout the data has in a receiver's pool. The
+ * alignment bytes of \0-bytes records are zeroed. Messages with many
+ * receivers are staged once, and every receiver copies the data from the
+ * kernel buffer, instead of faulting in and copying the sender's memory
+ * again for each of them.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_kmsg_vecs_stage(struct kdbus_kmsg *kmsg)
+{
+	const struct kdbus_item *item;
+	size_t pos = 0;
+	void *vecs;
+
+	if (kmsg->vecs || kmsg->vecs_size == 0)
+		return 0;
+
+	vecs = kmalloc(kmsg->vecs_size, GFP_KERNEL | __GFP_NOWARN);
+	if (!vecs) {
+		vecs = vmalloc(kmsg->vecs_size);
+		if (!vecs)
+			return -ENOMEM;
+	}
+
+	KDBUS_ITEM_FOREACH(item, &kmsg->msg, items) {
+		if (item->type != KDBUS_ITEM_PAYLOAD_VEC)
+			continue;
+
+		/* \0-bytes record */
+		if (!KDBUS_PTR(item->vec.address)) {
+			size_t pad = item->vec.size % 8;
+
+			memset(vecs + pos, 0, pad);
+			pos += pad;
+			continue;
+		}
+
+		if (copy_from_user(vecs + pos, KDBUS_PTR(item->vec.address),
+				   item->vec.size)) {
+			kdbus_kmsg_vecs_free(vecs);
+			return -EFAULT;
+		}
+
+		pos += item->vec.size;
+	}
+
+	kmsg->vecs = vecs;
+	return 0;
+}
+
 /**
  * kdbus_kmsg_new() - allocate message
  * @extra_size:		additional size to reserve for data
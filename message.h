@@ -16,13 +16,15 @@
 #include "util.h"
 #include "metadata.h"
 
+struct kdbus_name_atom;
+
 /**
  * struct kdbus_kmsg - internal message handling data
  * @seq:		Namespace-global message sequence number
  * @notify_type:	Short-cut for faster lookup
  * @notify_old_id:	Short-cut for faster lookup
  * @notify_new_id:	Short-cut for faster lookup
- * @notify_name:	Short-cut for faster lookup
+ * @notify_name:	Short-cut for faster lookup, ref'ed
  * @dst_name:		Short-cut to msg for faster lookup
  * @dst_name_id:	Short-cut to msg for faster lookup
  * @bloom:		Short-cut to msg for faster lookup
@@ -33,6 +35,9 @@
  * @vecs_size:		Size of PAYLOAD data
  * @vecs_count:		Number of PAYLOAD vectors
  * @memfds_count:	Number of memfds to pass
+ * @vecs:		Kernel copy of the PAYLOAD_VEC data, laid out as in the
+ *			receiver's pool; set up by kdbus_kmsg_vecs_stage()
+ * @arena_slice:	Copy of @vecs in the bus's broadcast arena
  * @queue_entry:	List of kernel-generated notifications
  * @msg:		Message from or to userspace
  */
@@ -41,7 +46,7 @@ struct kdbus_kmsg {
 	u64 notify_type;
 	u64 notify_old_id;
 	u64 notify_new_id;
-	const char *notify_name;
+	struct kdbus_name_atom *notify_name;
 
 	const char *dst_name;
 	u64 dst_name_id;
@@ -53,6 +58,8 @@ struct kdbus_kmsg {
 	size_t vecs_size;
 	unsigned int vecs_count;
 	unsigned int memfds_count;
+	void *vecs;
+	struct kdbus_arena_slice *arena_slice;
 	struct list_head queue_entry;
 
 	/* variable size, must be the last member */
@@ -67,4 +74,5 @@ int kdbus_kmsg_new_from_user(struct kdbus_conn *conn,
 			     struct kdbus_msg __user *msg,
 			     struct kdbus_kmsg **kmsg);
 void kdbus_kmsg_free(struct kdbus_kmsg *kmsg);
+int kdbus_kmsg_vecs_stage(struct kdbus_kmsg *kmsg);
 #endif
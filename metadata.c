@@ -204,7 +204,7 @@ static int kdbus_meta_append_src_names(struct kdbus_meta *meta,
 		size_t len;
 		size_t size;
 
-		len = strlen(e->name) + 1;
+		len = strlen(e->atom->name) + 1;
 		size = KDBUS_ITEM_SIZE(sizeof(struct kdbus_name) + len);
 
 		item = kdbus_meta_append_item(meta, size);
@@ -217,7 +217,7 @@ static int kdbus_meta_append_src_names(struct kdbus_meta *meta,
 		item->size = KDBUS_ITEM_HEADER_SIZE +
 				sizeof(struct kdbus_name) + len;
 		item->name.flags = e->flags;
-		memcpy(item->name.name, e->name, len);
+		memcpy(item->name.name, e->atom->name, len);
 	}
 	mutex_unlock(&conn->lock);
 
@@ -18,9 +18,11 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/security.h>
 
 #include "bus.h"
@@ -29,6 +31,7 @@
 #include "names.h"
 #include "notify.h"
 #include "policy.h"
+#include "rhash.h"
 
 /**
  * struct kdbus_name_queue_item - a queue item for a name
@@ -46,11 +49,18 @@ struct kdbus_name_queue_item {
 	struct list_head	conn_entry;
 };
 
-static void kdbus_name_entry_free(struct kdbus_name_entry *e)
+static void kdbus_name_entry_add(struct kdbus_name_registry *reg,
+				 struct kdbus_name_entry *e)
 {
-	hash_del(&e->hentry);
-	kfree(e->name);
-	kfree(e);
+	kdbus_rhash_add(&reg->entries_hash, &e->hentry, e->atom->hash);
+}
+
+static void kdbus_name_entry_free(struct kdbus_name_registry *reg,
+				  struct kdbus_name_entry *e)
+{
+	kdbus_rhash_del(&reg->entries_hash, &e->hentry);
+	kdbus_name_atom_unref(e->atom);
+	kfree_rcu(e, rcu);
 }
 
 /**
@@ -61,15 +71,21 @@ static void kdbus_name_entry_free(struct kdbus_name_entry *e)
  */
 void kdbus_name_registry_free(struct kdbus_name_registry *reg)
 {
+	struct kdbus_rhash_table *t;
 	struct kdbus_name_entry *e;
 	struct hlist_node *tmp;
 	unsigned int i;
 
 	mutex_lock(&reg->entries_lock);
-	hash_for_each_safe(reg->entries_hash, i, tmp, e, hentry)
-		kdbus_name_entry_free(e);
+	t = kdbus_rhash_table(&reg->entries_hash);
+	kdbus_rhash_for_each_safe(t, i, tmp, e, hentry) {
+		kdbus_name_atom_unref(e->atom);
+		kfree_rcu(e, rcu);
+	}
 	mutex_unlock(&reg->entries_lock);
 
+	kdbus_rhash_destroy(&reg->entries_hash);
+	kdbus_rhash_destroy(&reg->atoms_hash);
 	kfree(reg);
 }
 
@@ -82,27 +98,131 @@ void kdbus_name_registry_free(struct kdbus_name_registry *reg)
 int kdbus_name_registry_new(struct kdbus_name_registry **reg)
 {
 	struct kdbus_name_registry *r;
+	int ret;
 
 	r = kzalloc(sizeof(*r), GFP_KERNEL);
 	if (!r)
 		return -ENOMEM;
 
-	hash_init(r->entries_hash);
+	ret = kdbus_rhash_init(&r->entries_hash, &r->entries_lock);
+	if (ret < 0) {
+		kfree(r);
+		return ret;
+	}
+
+	ret = kdbus_rhash_init(&r->atoms_hash, &r->atoms_lock);
+	if (ret < 0) {
+		kdbus_rhash_destroy(&r->entries_hash);
+		kfree(r);
+		return ret;
+	}
+
 	mutex_init(&r->entries_lock);
+	mutex_init(&r->atoms_lock);
 
 	*reg = r;
 
 	return 0;
 }
 
+/**
+ * kdbus_name_atom_get() - intern a name
+ * @reg:		The name registry
+ * @name:		The name
+ * @atom:		The returned atom, ref'ed
+ *
+ * Return the atom of @name, which is created if the name is not yet used
+ * on the bus. Two names are equal if and only if their atoms are.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_name_atom_get(struct kdbus_name_registry *reg, const char *name,
+			struct kdbus_name_atom **atom)
+{
+	u32 hash = kdbus_str_hash(name);
+	struct kdbus_rhash_table *t;
+	struct kdbus_name_atom *a;
+	size_t len;
+
+	mutex_lock(&reg->atoms_lock);
+	t = kdbus_rhash_table(&reg->atoms_hash);
+	kdbus_rhash_for_each_possible(t, a, hentry, hash) {
+		if (a->hash != hash || strcmp(a->name, name) != 0)
+			continue;
+
+		kref_get(&a->kref);
+		goto exit_unlock;
+	}
+
+	len = strlen(name) + 1;
+	a = kmalloc(sizeof(*a) + len, GFP_KERNEL);
+	if (!a) {
+		mutex_unlock(&reg->atoms_lock);
+		return -ENOMEM;
+	}
+
+	kref_init(&a->kref);
+	a->reg = reg;
+	a->hash = hash;
+	memcpy(a->name, name, len);
+	kdbus_rhash_add(&reg->atoms_hash, &a->hentry, hash);
+
+exit_unlock:
+	mutex_unlock(&reg->atoms_lock);
+	*atom = a;
+
+	return 0;
+}
+
+/**
+ * kdbus_name_atom_ref() - take a reference on an atom
+ * @atom:		The atom
+ *
+ * Return: the atom itself
+ */
+struct kdbus_name_atom *kdbus_name_atom_ref(struct kdbus_name_atom *atom)
+{
+	kref_get(&atom->kref);
+	return atom;
+}
+
+static void __kdbus_name_atom_free(struct kref *kref)
+{
+	struct kdbus_name_atom *atom =
+		container_of(kref, struct kdbus_name_atom, kref);
+	struct kdbus_name_registry *reg = atom->reg;
+
+	kdbus_rhash_del(&reg->atoms_hash, &atom->hentry);
+	mutex_unlock(&reg->atoms_lock);
+
+	kfree_rcu(atom, rcu);
+}
+
+/**
+ * kdbus_name_atom_unref() - drop a reference on an atom
+ * @atom:		The atom, may be NULL
+ *
+ * The atom is removed from its registry with the last reference. The
+ * caller may hold any other lock.
+ */
+void kdbus_name_atom_unref(struct kdbus_name_atom *atom)
+{
+	if (!atom)
+		return;
+
+	kref_put_mutex(&atom->kref, __kdbus_name_atom_free,
+		       &atom->reg->atoms_lock);
+}
+
 static struct kdbus_name_entry *
 __kdbus_name_lookup(struct kdbus_name_registry *reg,
 		    u32 hash, const char *name)
 {
+	struct kdbus_rhash_table *t = kdbus_rhash_table(&reg->entries_hash);
 	struct kdbus_name_entry *e;
 
-	hash_for_each_possible(reg->entries_hash, e, hentry, hash)
-		if (strcmp(e->name, name) == 0)
+	kdbus_rhash_for_each_possible(t, e, hentry, hash)
+		if (e->atom->hash == hash && strcmp(e->atom->name, name) == 0)
 			return e;
 
 	return NULL;
@@ -115,36 +235,78 @@ static void kdbus_name_queue_item_free(struct kdbus_name_queue_item *q)
 	kfree(q);
 }
 
+/* the owner of a name entry, with the registry lock held */
+static inline struct kdbus_conn *
+kdbus_name_entry_conn(struct kdbus_name_entry *e)
+{
+	return rcu_dereference_protected(e->conn,
+				lockdep_is_held(&e->atom->reg->entries_lock));
+}
+
 static void kdbus_name_entry_remove_owner(struct kdbus_name_entry *e)
 {
-	struct kdbus_conn *conn = e->conn;
+	struct kdbus_conn *conn = kdbus_name_entry_conn(e);
 
-	BUG_ON(!e->conn);
+	BUG_ON(!conn);
 
 	mutex_lock(&conn->lock);
 	conn->names--;
 	list_del(&e->conn_entry);
 	mutex_unlock(&conn->lock);
 
+	RCU_INIT_POINTER(e->conn, NULL);
 	kdbus_conn_unref(conn);
-	e->conn = NULL;
 }
 
 static void kdbus_name_entry_set_owner(struct kdbus_name_entry *e,
 				       struct kdbus_conn *conn)
 {
-	BUG_ON(e->conn);
+	BUG_ON(kdbus_name_entry_conn(e));
 
 	mutex_lock(&conn->lock);
-	e->conn = kdbus_conn_ref(conn);
-	list_add_tail(&e->conn_entry, &e->conn->names_list);
+	rcu_assign_pointer(e->conn, kdbus_conn_ref(conn));
+	list_add_tail(&e->conn_entry, &conn->names_list);
 	conn->names++;
 	mutex_unlock(&conn->lock);
 }
 
-static int kdbus_name_entry_release(struct kdbus_name_entry *e,
-				     struct list_head *notify_list)
+/*
+ * Move the ownership of a name to another connection. Lock-free lookups
+ * must never see a name without an owner in between, so the new owner is
+ * published with a single store before the old owner's reference is
+ * dropped.
+ */
+static void kdbus_name_entry_hand_over(struct kdbus_name_entry *e,
+				       struct kdbus_conn *conn)
 {
+	struct kdbus_conn *old = kdbus_name_entry_conn(e);
+
+	BUG_ON(!old);
+
+	/* the owner keeps the name, the caller only updates the flags */
+	if (old == conn)
+		return;
+
+	mutex_lock(&old->lock);
+	old->names--;
+	list_del(&e->conn_entry);
+	mutex_unlock(&old->lock);
+
+	mutex_lock(&conn->lock);
+	rcu_assign_pointer(e->conn, kdbus_conn_ref(conn));
+	list_add_tail(&e->conn_entry, &conn->names_list);
+	conn->names++;
+	mutex_unlock(&conn->lock);
+
+	kdbus_conn_unref(old);
+}
+
+static int kdbus_name_entry_release(struct kdbus_name_registry *reg,
+				    struct kdbus_name_entry *e,
+				    struct list_head *notify_list)
+{
+	struct kdbus_conn *owner = kdbus_name_entry_conn(e);
+
 	/* give it to first waiter in the queue */
 	if (!list_empty(&e->queue_list)) {
 		struct kdbus_name_queue_item *q;
@@ -153,26 +315,25 @@ static int kdbus_name_entry_release(struct kdbus_name_entry *e,
 				     struct kdbus_name_queue_item,
 				     entry_entry);
 		kdbus_notify_name_change(KDBUS_ITEM_NAME_CHANGE,
-					 e->conn->id, q->conn->id,
-					 e->flags, q->flags, e->name, notify_list);
+					 owner->id, q->conn->id,
+					 e->flags, q->flags, e->atom, notify_list);
 		e->flags = q->flags;
-		kdbus_name_entry_remove_owner(e);
-		kdbus_name_entry_set_owner(e, q->conn);
+		kdbus_name_entry_hand_over(e, q->conn);
 		kdbus_name_queue_item_free(q);
 
 		return 0;
 	}
 
 	/* hand it back to the active activator connection */
-	if (e->activator && e->activator != e->conn &&
+	if (e->activator && e->activator != owner &&
 	    kdbus_conn_active(e->activator)) {
 		u64 flags = KDBUS_NAME_ACTIVATOR;
 		int ret;
 
 		kdbus_notify_name_change(KDBUS_ITEM_NAME_CHANGE,
-					 e->conn->id, e->activator->id,
+					 owner->id, e->activator->id,
 					 e->flags, flags,
-					 e->name, notify_list);
+					 e->atom, notify_list);
 
 		/*
 		 * Move messages still queued in the old connection
@@ -180,50 +341,60 @@ static int kdbus_name_entry_release(struct kdbus_name_entry *e,
 		 * This allows a race and loss-free name and message
 		 * takeover and exit-on-idle services.
 		 */
-		ret = kdbus_conn_move_messages(e->activator, e->conn,
+		ret = kdbus_conn_move_messages(e->activator, owner,
 					       e->name_id);
 		if (ret < 0)
 			return ret;
 
 		e->flags = flags;
-		kdbus_name_entry_remove_owner(e);
-		kdbus_name_entry_set_owner(e, e->activator);
+		kdbus_name_entry_hand_over(e, e->activator);
 
 		return 0;
 	}
 
 	/* release the name */
 	kdbus_notify_name_change(KDBUS_ITEM_NAME_REMOVE,
-				 e->conn->id, 0,
-				 e->flags, 0, e->name,
+				 owner->id, 0,
+				 e->flags, 0, e->atom,
 				 notify_list);
 	kdbus_name_entry_remove_owner(e);
 	kdbus_conn_unref(e->activator);
-	kdbus_name_entry_free(e);
+	kdbus_name_entry_free(reg, e);
 
 	return 0;
 }
 
-static int kdbus_name_release(struct kdbus_name_entry *e,
-			      struct kdbus_conn *conn,
-			      struct list_head *notify_list)
+/* remove the queue item of a connection waiting for the name, if any */
+static bool kdbus_name_queue_remove_conn(struct kdbus_name_entry *e,
+					 struct kdbus_conn *conn)
 {
 	struct kdbus_name_queue_item *q_tmp, *q;
 
+	list_for_each_entry_safe(q, q_tmp, &e->queue_list, entry_entry) {
+		if (q->conn != conn)
+			continue;
+		kdbus_name_queue_item_free(q);
+		return true;
+	}
+
+	return false;
+}
+
+static int kdbus_name_release(struct kdbus_name_registry *reg,
+			      struct kdbus_name_entry *e,
+			      struct kdbus_conn *conn,
+			      struct list_head *notify_list)
+{
 	/* Is the connection already the real owner of the name? */
-	if (e->conn == conn)
-		return kdbus_name_entry_release(e, notify_list);
+	if (kdbus_name_entry_conn(e) == conn)
+		return kdbus_name_entry_release(reg, e, notify_list);
 
 	/*
 	 * Otherwise, walk the list of queued entries and search for
 	 * items for the connection.
 	 */
-	list_for_each_entry_safe(q, q_tmp, &e->queue_list, entry_entry) {
-		if (q->conn != conn)
-			continue;
-		kdbus_name_queue_item_free(q);
+	if (kdbus_name_queue_remove_conn(e, conn))
 		return 0;
-	}
 
 	/* the name belongs to somebody else */
 	return -EADDRINUSE;
@@ -254,30 +425,68 @@ void kdbus_name_remove_by_conn(struct kdbus_name_registry *reg,
 	list_for_each_entry_safe(q, q_tmp, &names_queue_list, conn_entry)
 		kdbus_name_queue_item_free(q);
 	list_for_each_entry_safe(e, e_tmp, &names_list, conn_entry)
-		kdbus_name_entry_release(e, &notify_list);
+		kdbus_name_entry_release(reg, e, &notify_list);
 	mutex_unlock(&reg->entries_lock);
 
 	kdbus_conn_kmsg_list_send(conn->ep, &notify_list);
 }
 
 /**
- * kdbus_name_lookup() - look up a name in a name registry
+ * kdbus_name_lookup_conn() - find the connection a name is addressed to
  * @reg:		The name registry
  * @name:		The name to look up
+ * @name_id:		Returned sequence number of the name entry (may be
+ *			NULL)
+ * @conn:		Returned connection, ref'ed; the owner of the name, or
+ *			its activator
  *
- * Return: name entry if found, otherwise NULL.
+ * The registry is searched under rcu_read_lock(), without taking the
+ * registry lock, so lookups do not contend with each other or with the
+ * acquisition and release of names. The connection is pinned before the
+ * read-side section ends.
+ *
+ * Return: 0 on success, -ESRCH if the name is not registered, -ENXIO if
+ * the connection of the name is already going away.
  */
-struct kdbus_name_entry *kdbus_name_lookup(struct kdbus_name_registry *reg,
-					   const char *name)
+int kdbus_name_lookup_conn(struct kdbus_name_registry *reg,
+			   const char *name, u64 *name_id,
+			   struct kdbus_conn **conn)
 {
-	struct kdbus_name_entry *e = NULL;
 	u32 hash = kdbus_str_hash(name);
+	struct kdbus_rhash_table *t;
+	struct kdbus_name_entry *e;
+	int ret = -ESRCH;
 
-	mutex_lock(&reg->entries_lock);
-	e = __kdbus_name_lookup(reg, hash, name);
-	mutex_unlock(&reg->entries_lock);
+	rcu_read_lock();
+	t = rcu_dereference(reg->entries_hash.table);
+	kdbus_rhash_for_each_possible_rcu(t, e, hentry, hash) {
+		struct kdbus_conn *c;
+
+		if (e->atom->hash != hash || strcmp(e->atom->name, name) != 0)
+			continue;
 
-	return e;
+		c = rcu_dereference(e->conn);
+		if (!c)
+			c = ACCESS_ONCE(e->activator);
+
+		if (c)
+			c = kdbus_conn_ref_rcu(c);
+
+		if (!c) {
+			ret = -ENXIO;
+			break;
+		}
+
+		if (name_id)
+			*name_id = e->name_id;
+
+		*conn = c;
+		ret = 0;
+		break;
+	}
+	rcu_read_unlock();
+
+	return ret;
 }
 
 static int kdbus_name_queue_conn(struct kdbus_conn *conn, u64 flags,
@@ -308,15 +517,20 @@ static int kdbus_name_replace_owner(struct kdbus_name_registry *reg,
 	int ret;
 
 	ret = kdbus_notify_name_change(KDBUS_ITEM_NAME_CHANGE,
-				       e->conn->id, conn->id,
+				       kdbus_name_entry_conn(e)->id, conn->id,
 				       e->flags, flags,
-				       e->name, notify_list);
+				       e->atom, notify_list);
 	if (ret < 0)
 		return ret;
 
+	/*
+	 * The new owner may still wait for the name in its queue; it must
+	 * not get the name handed over a second time on the next release.
+	 */
+	kdbus_name_queue_remove_conn(e, conn);
+
 	/* hand over ownership */
-	kdbus_name_entry_remove_owner(e);
-	kdbus_name_entry_set_owner(e, conn);
+	kdbus_name_entry_hand_over(e, conn);
 	e->flags = flags;
 
 	return 0;
@@ -398,8 +612,10 @@ int kdbus_name_acquire(struct kdbus_name_registry *reg,
 	mutex_lock(&reg->entries_lock);
 	e = __kdbus_name_lookup(reg, hash, name);
 	if (e) {
+		struct kdbus_conn *owner = kdbus_name_entry_conn(e);
+
 		/* connection already owns that name */
-		if (e->conn == conn) {
+		if (owner == conn) {
 			ret = -EALREADY;
 			goto exit_unlock;
 		}
@@ -435,8 +651,7 @@ int kdbus_name_acquire(struct kdbus_name_registry *reg,
 			 * from a connection which asked for queuing.
 			 */
 			if (e->flags & KDBUS_NAME_QUEUE) {
-				ret = kdbus_name_queue_conn(e->conn,
-							    e->flags, e);
+				ret = kdbus_name_queue_conn(owner, e->flags, e);
 				if (ret < 0)
 					goto exit_unlock;
 			}
@@ -468,10 +683,9 @@ int kdbus_name_acquire(struct kdbus_name_registry *reg,
 		goto exit_unlock;
 	}
 
-	e->name = kstrdup(name, GFP_KERNEL);
-	if (!e->name) {
+	ret = kdbus_name_atom_get(reg, name, &e->atom);
+	if (ret < 0) {
 		kfree(e);
-		ret = -ENOMEM;
 		goto exit_unlock;
 	}
 
@@ -481,12 +695,12 @@ int kdbus_name_acquire(struct kdbus_name_registry *reg,
 	e->flags = *flags;
 	INIT_LIST_HEAD(&e->queue_list);
 	e->name_id = ++reg->name_seq_last;
-	hash_add(reg->entries_hash, &e->hentry, hash);
 	kdbus_name_entry_set_owner(e, conn);
+	kdbus_name_entry_add(reg, e);
 
 	kdbus_notify_name_change(KDBUS_ITEM_NAME_ADD,
-				 0, e->conn->id,
-				 0, e->flags, e->name,
+				 0, conn->id,
+				 0, e->flags, e->atom,
 				 &notify_list);
 
 	if (entry)
@@ -560,10 +774,7 @@ int kdbus_cmd_name_acquire(struct kdbus_name_registry *reg,
 			goto exit_free;
 		}
 
-		mutex_lock(&bus->lock);
 		new_conn = kdbus_bus_find_conn_by_id(bus, cmd_name->owner_id);
-		mutex_unlock(&bus->lock);
-
 		if (!new_conn) {
 			ret = -ENXIO;
 			goto exit_free;
@@ -597,7 +808,9 @@ int kdbus_cmd_name_acquire(struct kdbus_name_registry *reg,
 	if (copy_to_user(buf, cmd_name, size)) {
 		ret = -EFAULT;
 		kdbus_conn_kmsg_list_free(&notify_list);
-		kdbus_name_entry_release(e, NULL);
+		mutex_lock(&reg->entries_lock);
+		kdbus_name_entry_release(reg, e, NULL);
+		mutex_unlock(&reg->entries_lock);
 	}
 
 exit_unref_conn:
@@ -663,10 +876,7 @@ int kdbus_cmd_name_release(struct kdbus_name_registry *reg,
 			goto exit_unlock;
 		}
 
-		mutex_lock(&bus->lock);
 		conn = kdbus_bus_find_conn_by_id(bus, cmd_name->owner_id);
-		mutex_unlock(&bus->lock);
-
 		if (!conn) {
 			ret = -ENXIO;
 			goto exit_unlock;
@@ -675,7 +885,7 @@ int kdbus_cmd_name_release(struct kdbus_name_registry *reg,
 		kdbus_conn_ref(conn);
 	}
 
-	ret = kdbus_name_release(e, conn, &notify_list);
+	ret = kdbus_name_release(reg, e, conn, &notify_list);
 
 exit_unlock:
 	mutex_unlock(&reg->entries_lock);
@@ -690,120 +900,168 @@ exit_free:
 	return ret;
 }
 
-static int kdbus_name_list_write(struct kdbus_conn *conn,
+/**
+ * struct kdbus_name_list_buf - records of a name list being collected
+ * @data:		Buffer of the records, NULL while only the size of the
+ *			list is counted
+ * @size:		Size of @data
+ * @pos:		Size of the list collected so far
+ *
+ * The records are collected in a kernel buffer under the locks of the
+ * registry, and copied to the receiver's pool only after the locks are
+ * released.
+ */
+struct kdbus_name_list_buf {
+	u8			*data;
+	size_t			size;
+	size_t			pos;
+};
+
+static void *kdbus_name_list_buf_alloc(size_t size)
+{
+	if (size > PAGE_SIZE)
+		return vmalloc(size);
+
+	return kmalloc(size, GFP_KERNEL);
+}
+
+static void kdbus_name_list_buf_free(void *data)
+{
+	if (is_vmalloc_addr(data))
+		vfree(data);
+	else
+		kfree(data);
+}
+
+static int kdbus_name_list_write(struct kdbus_name_list_buf *b,
 				 struct kdbus_conn *c,
-				 size_t *pos,
-				 struct kdbus_name_entry *e,
-				 bool write)
+				 struct kdbus_name_entry *e)
 {
-	size_t p = *pos;
-	const size_t len = sizeof(struct kdbus_cmd_name);
-	size_t nlen = 0;
-	int ret = 0;
+	size_t nlen = e ? strlen(e->atom->name) + 1 : 0;
+	size_t len = sizeof(struct kdbus_cmd_name) + KDBUS_ALIGN8(nlen);
+	struct kdbus_cmd_name *n;
 
-	if (e)
-		nlen = strlen(e->name) + 1;
+	if (!b->data) {
+		b->pos += len;
+		return 0;
+	}
 
-	if (write) {
-		struct kdbus_cmd_name n = {
-			.size = len + nlen,
-			.owner_id = c->id,
-			.flags = e ? e->flags : 0,
-			.conn_flags = c->flags,
-		};
+	if (b->pos + len > b->size)
+		return -ENOBUFS;
 
-		/* write record */
-		ret = kdbus_pool_write(conn->pool, p, &n, len);
-		if (ret < 0)
-			return ret;
-		p += len;
+	n = (struct kdbus_cmd_name *)(b->data + b->pos);
+	n->size = sizeof(struct kdbus_cmd_name) + nlen;
+	n->flags = e ? e->flags : 0;
+	n->owner_id = c->id;
+	n->conn_flags = c->flags;
 
-		/* append name */
-		if (e) {
-			ret = kdbus_pool_write(conn->pool, p, e->name, nlen);
-			if (ret < 0)
-				return ret;
-			p += KDBUS_ALIGN8(nlen);
-		}
-	} else {
-		p += len + KDBUS_ALIGN8(nlen);
+	/* append name */
+	if (e) {
+		memcpy(n->name, e->atom->name, nlen);
+		memset(n->name + nlen, 0, KDBUS_ALIGN8(nlen) - nlen);
 	}
 
-	*pos = p;
+	b->pos += len;
 	return 0;
 }
 
-static int kdbus_name_list_all(struct kdbus_conn *conn, u64 flags,
-			       size_t *pos, bool write)
+/* collect the records of one connection */
+static int kdbus_name_list_conn(struct kdbus_name_list_buf *b,
+				struct kdbus_conn *c, u64 flags)
 {
-	struct kdbus_conn *c;
-	size_t p = *pos;
-	int ret, i;
+	bool added = false;
+	int ret;
 
-	hash_for_each(conn->ep->bus->conn_hash, i, c, hentry) {
-		bool added = false;
+	/* skip activators */
+	if (!(flags & KDBUS_NAME_LIST_ACTIVATORS) &&
+	    c->flags & KDBUS_HELLO_ACTIVATOR)
+		return 0;
 
-		/* skip activators */
-		if (!(flags & KDBUS_NAME_LIST_ACTIVATORS) &&
-		    c->flags & KDBUS_HELLO_ACTIVATOR)
-			continue;
+	/* all names the connection owns */
+	if (flags & (KDBUS_NAME_LIST_NAMES | KDBUS_NAME_LIST_ACTIVATORS)) {
+		struct kdbus_name_entry *e;
 
-		/* all names the connection owns */
-		if (flags & (KDBUS_NAME_LIST_NAMES |
-			     KDBUS_NAME_LIST_ACTIVATORS)) {
-			struct kdbus_name_entry *e;
-
-			list_for_each_entry(e, &c->names_list, conn_entry) {
-				struct kdbus_conn *a = e->activator;
-
-				if ((flags & KDBUS_NAME_LIST_ACTIVATORS) &&
-				    a && a != c) {
-					ret = kdbus_name_list_write(conn, a, &p,
-								    e, write);
-					if (ret < 0)
-						return ret;
-
-					added = true;
-				}
-
-				if (flags & KDBUS_NAME_LIST_NAMES ||
-				    c->flags & KDBUS_HELLO_ACTIVATOR) {
-					ret = kdbus_name_list_write(conn, c, &p,
-								    e, write);
-					if (ret < 0)
-						return ret;
-
-					added = true;
-				}
-			}
-		}
+		list_for_each_entry(e, &c->names_list, conn_entry) {
+			struct kdbus_conn *a = e->activator;
 
-		/* queue of names the connection is currently waiting for */
-		if (flags & KDBUS_NAME_LIST_QUEUED) {
-			struct kdbus_name_queue_item *q;
+			if ((flags & KDBUS_NAME_LIST_ACTIVATORS) &&
+			    a && a != c) {
+				ret = kdbus_name_list_write(b, a, e);
+				if (ret < 0)
+					return ret;
+
+				added = true;
+			}
 
-			list_for_each_entry(q, &c->names_queue_list, conn_entry) {
-				ret = kdbus_name_list_write(conn, c, &p,
-							    q->entry, write);
+			if (flags & KDBUS_NAME_LIST_NAMES ||
+			    c->flags & KDBUS_HELLO_ACTIVATOR) {
+				ret = kdbus_name_list_write(b, c, e);
 				if (ret < 0)
 					return ret;
 
 				added = true;
 			}
 		}
+	}
+
+	/* queue of names the connection is currently waiting for */
+	if (flags & KDBUS_NAME_LIST_QUEUED) {
+		struct kdbus_name_queue_item *q;
 
-		/* nothing added so far, just add the unique ID */
-		if (!added && flags & KDBUS_NAME_LIST_UNIQUE) {
-			ret = kdbus_name_list_write(conn, c, &p, NULL, write);
+		list_for_each_entry(q, &c->names_queue_list, conn_entry) {
+			ret = kdbus_name_list_write(b, c, q->entry);
 			if (ret < 0)
 				return ret;
+
+			added = true;
 		}
 	}
 
-	*pos = p;
+	/* nothing added so far, just add the unique ID */
+	if (!added && flags & KDBUS_NAME_LIST_UNIQUE) {
+		ret = kdbus_name_list_write(b, c, NULL);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int kdbus_name_list_all(struct kdbus_bus *bus, u64 flags,
+			       struct kdbus_name_list_buf *b)
+{
+	struct kdbus_conn *c;
+	int ret;
+
+	list_for_each_entry(c, &bus->conn_list, bus_entry) {
+		ret = kdbus_name_list_conn(b, c, flags);
+		if (ret < 0)
+			return ret;
+	}
+
 	return 0;
 }
 
+/* copy a collected list, its header included, to the pool of @conn */
+static int kdbus_name_list_copy(struct kdbus_conn *conn,
+				struct kdbus_name_list_buf *b, size_t *off)
+{
+	struct kdbus_name_list *list = (struct kdbus_name_list *)b->data;
+	int ret;
+
+	list->size = b->pos;
+
+	ret = kdbus_pool_alloc_range(conn->pool, b->pos, off);
+	if (ret < 0)
+		return ret;
+
+	ret = kdbus_pool_write(conn->pool, *off, b->data, b->pos);
+	if (ret < 0)
+		kdbus_pool_free_range(conn->pool, *off);
+
+	return ret;
+}
+
 /**
  * kdbus_cmd_name_list() - list names of a connection
  * @reg:		The name registry
@@ -816,10 +1074,10 @@ int kdbus_cmd_name_list(struct kdbus_name_registry *reg,
 			struct kdbus_conn *conn,
 			void __user *buf)
 {
+	struct kdbus_bus *bus = conn->ep->bus;
 	struct kdbus_cmd_name_list *cmd_list;
-	struct kdbus_name_list list = {};
-	size_t size;
-	size_t off, pos;
+	struct kdbus_name_list_buf b = {};
+	size_t off;
 	int ret;
 
 	cmd_list = memdup_user(buf, sizeof(struct kdbus_cmd_name_list));
@@ -827,46 +1085,136 @@ int kdbus_cmd_name_list(struct kdbus_name_registry *reg,
 		return PTR_ERR(cmd_list);
 
 	mutex_lock(&reg->entries_lock);
-	mutex_lock(&conn->ep->bus->lock);
-
-	/* size of header */
-	size = sizeof(struct kdbus_name_list);
+	mutex_lock(&bus->lock);
 
-	/* size of records */
-	ret = kdbus_name_list_all(conn, cmd_list->flags, &size, false);
+	/* size of header and records */
+	b.pos = sizeof(struct kdbus_name_list);
+	ret = kdbus_name_list_all(bus, cmd_list->flags, &b);
 	if (ret < 0)
 		goto exit_unlock;
 
-	ret = kdbus_pool_alloc_range(conn->pool, size, &off);
-	if (ret < 0)
+	b.size = b.pos;
+	b.data = kdbus_name_list_buf_alloc(b.size);
+	if (!b.data) {
+		ret = -ENOMEM;
 		goto exit_unlock;
+	}
 
-	/* copy header */
-	pos = off;
-	list.size = size;
+	/* copy data */
+	b.pos = sizeof(struct kdbus_name_list);
+	ret = kdbus_name_list_all(bus, cmd_list->flags, &b);
+
+exit_unlock:
+	mutex_unlock(&bus->lock);
+	mutex_unlock(&reg->entries_lock);
 
-	ret = kdbus_pool_write(conn->pool, pos,
-			       &list, sizeof(struct kdbus_name_list));
 	if (ret < 0)
-		goto exit_pool_free;
-	pos += sizeof(struct kdbus_name_list);
+		goto exit_free;
 
-	/* copy data */
-	ret = kdbus_name_list_all(conn, cmd_list->flags, &pos, true);
+	ret = kdbus_name_list_copy(conn, &b, &off);
 	if (ret < 0)
-		goto exit_pool_free;
+		goto exit_free;
 
 	/* return allocated data */
-	if (kdbus_offset_set_user(&off, buf, struct kdbus_cmd_name_list))
+	if (kdbus_offset_set_user(&off, buf, struct kdbus_cmd_name_list)) {
+		kdbus_pool_free_range(conn->pool, off);
 		ret = -EFAULT;
+	}
+
+exit_free:
+	kdbus_name_list_buf_free(b.data);
+	kfree(cmd_list);
+
+	return ret;
+}
+
+/**
+ * kdbus_cmd_name_list_batch() - list names, one batch at a time
+ * @reg:		The name registry
+ * @conn:		The connection to return the list to
+ * @buf:		The __user buffer as passed in by the ioctl
+ *
+ * The connections are visited in the order of their IDs, starting at the
+ * cursor. Every step to the next connection takes the bus lock briefly,
+ * in kdbus_bus_find_conn_next(); the records of a connection are collected
+ * with only its own lock and the registry lock held, so the bus is never
+ * locked for the whole walk. The batch ends before the first connection
+ * whose records do not fit into the remaining space, whose ID is returned
+ * as the cursor to continue with.
+ *
+ * Return: 0 on success, -ENOBUFS if the records of a single connection
+ * exceed the maximum size of the batch, negative errno on failure.
+ */
+int kdbus_cmd_name_list_batch(struct kdbus_name_registry *reg,
+			      struct kdbus_conn *conn,
+			      void __user *buf)
+{
+	struct kdbus_cmd_name_list_batch __user *ubuf = buf;
+	struct kdbus_bus *bus = conn->ep->bus;
+	struct kdbus_cmd_name_list_batch cmd;
+	struct kdbus_name_list_buf b = {};
+	struct kdbus_conn *c, *next;
+	u64 cursor = 0;
+	size_t off;
+	int ret = 0;
+
+	if (copy_from_user(&cmd, buf, sizeof(cmd)))
+		return -EFAULT;
+
+	if (cmd.size != sizeof(cmd))
+		return -EINVAL;
+
+	if (cmd.max_size < sizeof(struct kdbus_name_list))
+		return -EINVAL;
+
+	b.size = min_t(u64, cmd.max_size, KDBUS_NAME_LIST_BATCH_MAX_SIZE);
+	b.data = kdbus_name_list_buf_alloc(b.size);
+	if (!b.data)
+		return -ENOMEM;
+
+	b.pos = sizeof(struct kdbus_name_list);
+
+	for (c = kdbus_bus_find_conn_next(bus, NULL, cmd.cursor); c; c = next) {
+		size_t pos = b.pos;
+
+		mutex_lock(&reg->entries_lock);
+		mutex_lock(&c->lock);
+		ret = kdbus_name_list_conn(&b, c, cmd.flags);
+		mutex_unlock(&c->lock);
+		mutex_unlock(&reg->entries_lock);
+
+		if (ret == -ENOBUFS && pos > sizeof(struct kdbus_name_list)) {
+			/* drop the partial records, continue here next time */
+			b.pos = pos;
+			cursor = c->id;
+			ret = 0;
+		}
+
+		if (ret < 0 || cursor > 0) {
+			kdbus_conn_unref(c);
+			break;
+		}
+
+		next = kdbus_bus_find_conn_next(bus, c, c->id + 1);
+		kdbus_conn_unref(c);
+	}
 
-exit_pool_free:
 	if (ret < 0)
+		goto exit_free;
+
+	ret = kdbus_name_list_copy(conn, &b, &off);
+	if (ret < 0)
+		goto exit_free;
+
+	if (kdbus_offset_set_user(&off, buf,
+				  struct kdbus_cmd_name_list_batch) ||
+	    copy_to_user(&ubuf->cursor, &cursor, sizeof(cursor))) {
 		kdbus_pool_free_range(conn->pool, off);
-exit_unlock:
-	mutex_unlock(&conn->ep->bus->lock);
-	mutex_unlock(&reg->entries_lock);
-	kfree(cmd_list);
+		ret = -EFAULT;
+	}
+
+exit_free:
+	kdbus_name_list_buf_free(b.data);
 
 	return ret;
 }
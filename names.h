@@ -14,45 +14,89 @@
 #define __KDBUS_NAMES_H
 
 #include <linux/hashtable.h>
+#include <linux/kref.h>
+
+#include "rhash.h"
 
 /**
  * struct kdbus_name_registry - names registered for a bus
- * @entries_hash:	Map of entries
- * @entries_lock:	Registry data lock
+ * @entries_hash:	Hash table of entries, entries are added and removed
+ *			with RCU; it grows and shrinks with the number of
+ *			entries
+ * @entries_lock:	Registry data lock, not taken by
+ *			kdbus_name_lookup_conn()
  * @name_seq_last:	Last used sequence number to assign to a name entry
+ * @atoms_hash:		Map of the interned names of the bus; it grows and
+ *			shrinks with the number of names
+ * @atoms_lock:		Lock of @atoms_hash, taken after any other lock
  */
 struct kdbus_name_registry {
-	DECLARE_HASHTABLE(entries_hash, 8);
+	struct kdbus_rhash	entries_hash;
 	struct mutex		entries_lock;
 	u64 name_seq_last;
+	struct kdbus_rhash	atoms_hash;
+	struct mutex		atoms_lock;
+};
+
+/**
+ * struct kdbus_name_atom - interned name
+ * @kref:		Reference count
+ * @reg:		The registry the name is interned in
+ * @hentry:		Entry in the registry's atom map
+ * @hash:		The hash of @name
+ * @rcu:		RCU head, the atom of a name entry may still be read
+ *			by kdbus_name_lookup_conn()
+ * @name:		The name
+ *
+ * Every name used on a bus is stored only once: name entries, policy
+ * entries, match rules and kernel notifications about a name all hold a
+ * reference to the same atom, and compare names by comparing the atom
+ * pointers.
+ */
+struct kdbus_name_atom {
+	struct kref		kref;
+	struct kdbus_name_registry *reg;
+	struct kdbus_rhash_node	hentry;
+	u32			hash;
+	struct rcu_head		rcu;
+	char			name[0];
 };
 
 /**
  * struct kdbus_name_entry - well-know name entry
- * @name:		The well-known name
+ * @atom:		The well-known name
  * @name_id:		Sequence number of name entry to be able to uniquely
  *			identify a name over its registration lifetime
  * @flags:		KDBUS_NAME_* flags
  * @queue_list:		List of queued waiters for the well-known name
  * @conn_entry:		Entry in connection
- * @hentry:		Entry in registry map
- * @conn:		Connection owning the name
+ * @hentry:		Entry in the registry's hash table
+ * @conn:		Connection owning the name, published with RCU for
+ *			kdbus_name_lookup_conn()
  * @activator:		Connection of the activator queuing incoming messages
+ * @rcu:		RCU head, entries are looked up without taking the
+ *			registry lock and freed after all readers are done
  */
 struct kdbus_name_entry {
-	char			*name;
+	struct kdbus_name_atom	*atom;
 	u64			name_id;
 	u64			flags;
 	struct list_head	queue_list;
 	struct list_head	conn_entry;
-	struct hlist_node	hentry;
-	struct kdbus_conn	*conn;
+	struct kdbus_rhash_node	hentry;
+	struct kdbus_conn __rcu	*conn;
 	struct kdbus_conn	*activator;
+	struct rcu_head		rcu;
 };
 
 int kdbus_name_registry_new(struct kdbus_name_registry **reg);
 void kdbus_name_registry_free(struct kdbus_name_registry *reg);
 
+int kdbus_name_atom_get(struct kdbus_name_registry *reg, const char *name,
+			struct kdbus_name_atom **atom);
+struct kdbus_name_atom *kdbus_name_atom_ref(struct kdbus_name_atom *atom);
+void kdbus_name_atom_unref(struct kdbus_name_atom *atom);
+
 int kdbus_name_acquire(struct kdbus_name_registry *reg,
 		       struct kdbus_conn *conn,
 		       const char *name, u64 *flags,
@@ -66,9 +110,13 @@ int kdbus_cmd_name_release(struct kdbus_name_registry *reg,
 int kdbus_cmd_name_list(struct kdbus_name_registry *reg,
 			struct kdbus_conn *conn,
 			void __user *buf);
+int kdbus_cmd_name_list_batch(struct kdbus_name_registry *reg,
+			      struct kdbus_conn *conn,
+			      void __user *buf);
 
-struct kdbus_name_entry *kdbus_name_lookup(struct kdbus_name_registry *reg,
-					   const char *name);
+int kdbus_name_lookup_conn(struct kdbus_name_registry *reg,
+			   const char *name, u64 *name_id,
+			   struct kdbus_conn **conn);
 void kdbus_name_remove_by_conn(struct kdbus_name_registry *reg,
 			       struct kdbus_conn *conn);
 
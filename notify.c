@@ -19,6 +19,7 @@
 #include <linux/slab.h>
 
 #include "message.h"
+#include "names.h"
 #include "notify.h"
 
 static int kdbus_notify_reply(u64 id, u64 cookie, u64 msg_type,
@@ -97,7 +98,8 @@ int kdbus_notify_reply_dead(u64 id, u64 cookie, struct list_head *queue_list)
  *			the old owner
  * @new_flags:		The flags to pass in the KDBUS_ITEM flags field for
  *			the new owner
- * @name:		The name that was removed or assigned to a new owner
+ * @atom:		The name that was removed or assigned to a new owner;
+ *			the message takes a reference on it
  * @queue_list:		A queue list for the newly generated kdbus_kmsg.
  *			The caller has to free all items in the list using
  *			kdbus_kmsg_free(). Maybe NULL, in which case this
@@ -108,7 +110,7 @@ int kdbus_notify_reply_dead(u64 id, u64 cookie, struct list_head *queue_list)
 int kdbus_notify_name_change(u64 type,
 			     u64 old_id, u64 new_id,
 			     u64 old_flags, u64 new_flags,
-			     const char *name,
+			     struct kdbus_name_atom *atom,
 			     struct list_head *queue_list)
 {
 	struct kdbus_kmsg *kmsg = NULL;
@@ -119,7 +121,7 @@ int kdbus_notify_name_change(u64 type,
 	if (!queue_list)
 		return 0;
 
-	name_len = strlen(name) + 1;
+	name_len = strlen(atom->name) + 1;
 	extra_size = sizeof(struct kdbus_notify_name_change) + name_len;
 	ret = kdbus_kmsg_new(extra_size, &kmsg);
 	if (ret < 0)
@@ -135,8 +137,8 @@ int kdbus_notify_name_change(u64 type,
 	kmsg->msg.items[0].name_change.old.flags = old_flags;
 	kmsg->msg.items[0].name_change.new.id = new_id;
 	kmsg->msg.items[0].name_change.new.flags = new_flags;
-	memcpy(kmsg->msg.items[0].name_change.name, name, name_len);
-	kmsg->notify_name = kmsg->msg.items[0].name_change.name;
+	memcpy(kmsg->msg.items[0].name_change.name, atom->name, name_len);
+	kmsg->notify_name = kdbus_name_atom_ref(atom);
 
 	list_add_tail(&kmsg->queue_entry, queue_list);
 	return ret;
@@ -13,6 +13,8 @@
 #ifndef __KDBUS_NOTIFY_H
 #define __KDBUS_NOTIFY_H
 
+struct kdbus_name_atom;
+
 int kdbus_notify_id_change(u64 type, u64 id, u64 flags,
 			   struct list_head *queue_list);
 int kdbus_notify_reply_timeout(u64 id, u64 cookie,
@@ -22,6 +24,6 @@ int kdbus_notify_reply_dead(u64 id, u64 cookie,
 int kdbus_notify_name_change(u64 type,
 			     u64 old_id, u64 new_id,
 			     u64 old_flags, u64 new_flags,
-			     const char *name,
+			     struct kdbus_name_atom *atom,
 			     struct list_head *queue_list);
 #endif
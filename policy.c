@@ -73,13 +73,13 @@ struct kdbus_policy_db_entry_access {
 
 /**
  * struct kdbus_policy_db_entry - a policy database entry
- * @name:		The name to match the policy entry against
+ * @atom:		The name to match the policy entry against
  * @hentry:		The hash entry for the database's entries_hash
  * @access_list:	List head for keeping tracks of the entry's
  *			access items.
  */
 struct kdbus_policy_db_entry {
-	char			*name;
+	struct kdbus_name_atom	*atom;
 	struct hlist_node	hentry;
 	struct list_head	access_list;
 };
@@ -106,7 +106,7 @@ void kdbus_policy_db_free(struct kdbus_policy_db *db)
 		}
 
 		hash_del(&e->hentry);
-		kfree(e->name);
+		kdbus_name_atom_unref(e->atom);
 		kfree(e);
 	}
 	mutex_unlock(&db->entries_lock);
@@ -182,7 +182,6 @@ static int __kdbus_policy_db_check_send_access(struct kdbus_policy_db *db,
 	struct kdbus_name_entry *name_entry;
 	struct kdbus_policy_db_entry *db_entry;
 	u64 access;
-	u32 hash;
 	int ret = -EPERM;
 
 	/*
@@ -194,9 +193,9 @@ static int __kdbus_policy_db_check_send_access(struct kdbus_policy_db *db,
 	 */
 	mutex_lock(&conn_src->lock);
 	list_for_each_entry(name_entry, &conn_src->names_list, conn_entry) {
-		hash = kdbus_str_hash(name_entry->name);
-		hash_for_each_possible(db->entries_hash, db_entry, hentry, hash) {
-			if (strcmp(db_entry->name, name_entry->name) != 0)
+		hash_for_each_possible(db->entries_hash, db_entry, hentry,
+				       name_entry->atom->hash) {
+			if (db_entry->atom != name_entry->atom)
 				continue;
 
 			access = kdbus_collect_entry_accesses(db_entry, conn_src);
@@ -213,9 +212,9 @@ static int __kdbus_policy_db_check_send_access(struct kdbus_policy_db *db,
 
 	mutex_lock(&conn_dst->lock);
 	list_for_each_entry(name_entry, &conn_dst->names_list, conn_entry) {
-		hash = kdbus_str_hash(name_entry->name);
-		hash_for_each_possible(db->entries_hash, db_entry, hentry, hash) {
-			if (strcmp(db_entry->name, name_entry->name) != 0)
+		hash_for_each_possible(db->entries_hash, db_entry, hentry,
+				       name_entry->atom->hash) {
+			if (db_entry->atom != name_entry->atom)
 				continue;
 
 			access = kdbus_collect_entry_accesses(db_entry, conn_dst);
@@ -346,7 +345,8 @@ bool kdbus_policy_db_check_own_access(struct kdbus_policy_db *db,
 			       hentry, hash) {
 		u64 access;
 
-		if (strcmp(db_entry->name, name) != 0)
+		if (db_entry->atom->hash != hash ||
+		    strcmp(db_entry->atom->name, name) != 0)
 			continue;
 
 		access = kdbus_collect_entry_accesses(db_entry, conn);
@@ -363,6 +363,7 @@ exit_unlock:
 }
 
 static int kdbus_policy_db_parse(struct kdbus_policy_db *db,
+				 struct kdbus_name_registry *reg,
 				 const struct kdbus_cmd_policy *cmd,
 				 u64 size)
 {
@@ -376,18 +377,23 @@ static int kdbus_policy_db_parse(struct kdbus_policy_db *db,
 		switch (item->type) {
 		case KDBUS_ITEM_POLICY_NAME: {
 			struct kdbus_policy_db_entry *e;
-			u32 hash;
+			int ret;
 
 			e = kzalloc(sizeof(*e), GFP_KERNEL);
 			if (!e)
 				return -ENOMEM;
 
-			hash = kdbus_str_hash(item->policy.name);
-			e->name = kstrdup(item->policy.name, GFP_KERNEL);
+			ret = kdbus_name_atom_get(reg, item->policy.name,
+						  &e->atom);
+			if (ret < 0) {
+				kfree(e);
+				return ret;
+			}
+
 			INIT_LIST_HEAD(&e->access_list);
 
 			mutex_lock(&db->entries_lock);
-			hash_add(db->entries_hash, &e->hentry, hash);
+			hash_add(db->entries_hash, &e->hentry, e->atom->hash);
 			mutex_unlock(&db->entries_lock);
 
 			current_entry = e;
@@ -433,6 +439,7 @@ static int kdbus_policy_db_parse(struct kdbus_policy_db *db,
 /**
  * kdbus_cmd_policy_set_from_user() - set a connection's policy rules
  * @db:		The policy database
+ * @reg:	The name registry of the bus, the names are interned in
  * @buf:	The __user buffer that was provided by the ioctl() call
  *
  * This function is used in the context of the KDBUS_CMD_EP_POLICY_SET
@@ -440,7 +447,9 @@ static int kdbus_policy_db_parse(struct kdbus_policy_db *db,
  *
  * Return: 0 on success, negative errno on failure
  */
-int kdbus_cmd_policy_set_from_user(struct kdbus_policy_db *db, void __user *buf)
+int kdbus_cmd_policy_set_from_user(struct kdbus_policy_db *db,
+				   struct kdbus_name_registry *reg,
+				   void __user *buf)
 {
 	struct kdbus_cmd_policy *cmd;
 	u64 size;
@@ -459,7 +468,7 @@ int kdbus_cmd_policy_set_from_user(struct kdbus_policy_db *db, void __user *buf)
 	if (IS_ERR(cmd))
 		return PTR_ERR(cmd);
 
-	ret = kdbus_policy_db_parse(db, cmd, size);
+	ret = kdbus_policy_db_parse(db, reg, cmd, size);
 	kfree(cmd);
 
 	return ret;
@@ -14,11 +14,13 @@
 #define __KDBUS_POLICY_H
 
 struct kdbus_conn;
+struct kdbus_name_registry;
 struct kdbus_policy_db;
 
 int kdbus_policy_db_new(struct kdbus_policy_db **db);
 void kdbus_policy_db_free(struct kdbus_policy_db *db);
 int kdbus_cmd_policy_set_from_user(struct kdbus_policy_db *db,
+				   struct kdbus_name_registry *reg,
 				   void __user *buf);
 int kdbus_policy_db_check_send_access(struct kdbus_policy_db *db,
 				      struct kdbus_conn *conn_src,
@@ -11,6 +11,7 @@
  */
 
 #include <linux/aio.h>
+#include <linux/falloc.h>
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/highmem.h>
@@ -24,19 +25,80 @@
 #include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 
+#include "defaults.h"
 #include "util.h"
 #include "pool.h"
 
+static unsigned int kdbus_pool_release_min = KDBUS_POOL_RELEASE_MIN;
+module_param_named(pool_release_min, kdbus_pool_release_min, uint, 0644);
+MODULE_PARM_DESC(pool_release_min,
+		 "Minimum size of a free pool region to release its memory");
+
+/*
+ * Small allocations are served from runs: slices of KDBUS_POOL_RUN_SIZE
+ * bytes taken from the slice allocator and split into objects of a single
+ * size class, which are managed with a bitmap. The size classes are the
+ * powers of two from 64 bytes to 1 KiB; larger allocations use the slice
+ * allocator directly.
+ */
+#define KDBUS_POOL_CLASS_SHIFT		6
+#define KDBUS_POOL_CLASSES		5
+#define KDBUS_POOL_SMALL_MAX		(1UL << (KDBUS_POOL_CLASS_SHIFT + \
+						 KDBUS_POOL_CLASSES - 1))
+#define KDBUS_POOL_RUN_SIZE		SZ_16K
+#define KDBUS_POOL_RUN_OBJS_MAX		(KDBUS_POOL_RUN_SIZE >> \
+					 KDBUS_POOL_CLASS_SHIFT)
+
+/* initial number of allocation records of a pool in FIFO mode */
+#define KDBUS_POOL_FIFO_RECS		64
+
+/**
+ * struct kdbus_pool_fifo_rec - allocation in a pool in FIFO mode
+ * @off:		Offset of the allocation in the shmem file
+ * @size:		Size of the allocation
+ */
+struct kdbus_pool_fifo_rec {
+	size_t off;
+	size_t size;
+};
+
+/**
+ * struct kdbus_pool_fifo - state of a pool in FIFO mode
+ * @recs:		Allocation records, in allocation order
+ * @n_recs:		Number of elements of @recs, a power of two
+ * @first:		Index of the oldest record
+ * @count:		Number of live records
+ * @head:		Offset of the next allocation
+ *
+ * The pool is used as a ring buffer: allocations are placed at @head,
+ * which wraps around to the start of the pool when the end is reached;
+ * the oldest allocation marks the tail. Freeing the oldest allocation
+ * only advances the tail.
+ */
+struct kdbus_pool_fifo {
+	struct kdbus_pool_fifo_rec *recs;
+	unsigned int n_recs;
+	unsigned int first;
+	unsigned int count;
+	size_t head;
+};
+
 /**
  * struct kdbus_pool - the receiver's buffer
  * @f:			The backing shmem file
  * @size:		The size of the file
- * @busy:		The currently used size
+ * @busy:		The currently used size; a run counts in full as soon
+ *			as it is carved from the free slices
  * @lock:		Pool data lock
  * @slices:		All slices sorted by address
  * @slices_busy:	Tree of allocated slices
  * @slices_free:	Tree of free slices
+ * @runs:		Runs with free objects, per size class
+ * @fifo:		Ring buffer state, NULL if the slice allocator is used
+ * @pages:		The pinned pages of a mapped pool
+ * @kaddr:		Kernel mapping of @pages, NULL if the pool is not mapped
  *
  * The receiver's buffer, managed as a pool of allocated and free
  * slices containing the queued messages.
@@ -59,6 +121,10 @@ struct kdbus_pool {
 	struct list_head slices;
 	struct rb_root slices_busy;
 	struct rb_root slices_free;
+	struct list_head runs[KDBUS_POOL_CLASSES];
+	struct kdbus_pool_fifo *fifo;
+	struct page **pages;
+	void *kaddr;
 };
 
 /**
@@ -68,6 +134,7 @@ struct kdbus_pool {
  * @entry:		Entry in "all slices" list
  * @rb_node:		Entry in free or busy list
  * @free:		Unused slice
+ * @run:		The run of small objects carved out of this slice
  *
  * The pool has one or more slices, always spanning the entire size of the
  * pool.
@@ -86,6 +153,23 @@ struct kdbus_slice {
 	struct list_head entry;
 	struct rb_node rb_node;
 	bool free;
+	struct kdbus_pool_run *run;
+};
+
+/**
+ * struct kdbus_pool_run - busy slice split into small objects
+ * @slice:		The slice holding the objects
+ * @entry:		Entry in the pool's list of runs with free objects
+ * @class:		The size class of the objects
+ * @used:		The number of allocated objects
+ * @map:		Bitmap of allocated objects
+ */
+struct kdbus_pool_run {
+	struct kdbus_slice *slice;
+	struct list_head entry;
+	unsigned int class;
+	unsigned int used;
+	DECLARE_BITMAP(map, KDBUS_POOL_RUN_OBJS_MAX);
 };
 
 static struct kdbus_slice *kdbus_pool_slice_new(size_t off, size_t size)
@@ -102,6 +186,36 @@ static struct kdbus_slice *kdbus_pool_slice_new(size_t off, size_t size)
 	return slice;
 }
 
+/*
+ * Release the pages backing the range [@lo, @hi) of the free region
+ * [@first, @last); pages which reach beyond the free region are left alone.
+ * Must be called with the pool lock held, so the range cannot be allocated
+ * and written to concurrently.
+ */
+static void kdbus_pool_release(struct kdbus_pool *pool, size_t lo, size_t hi,
+			       size_t first, size_t last)
+{
+	loff_t start = round_down(lo, PAGE_SIZE);
+	loff_t end = round_up(hi, PAGE_SIZE);
+
+	/* the pinned pages of a mapped pool must stay in the file */
+	if (pool->kaddr)
+		return;
+
+	if (start < first)
+		start += PAGE_SIZE;
+
+	if (end > last)
+		end -= PAGE_SIZE;
+
+	if (start >= end)
+		return;
+
+	pool->f->f_op->fallocate(pool->f,
+				 FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				 start, end - start);
+}
+
 /* insert a slice into the free tree */
 static void kdbus_pool_add_free_slice(struct kdbus_pool *pool,
 				      struct kdbus_slice *slice)
@@ -148,10 +262,11 @@ static void kdbus_pool_add_busy_slice(struct kdbus_pool *pool,
 	rb_insert_color(&slice->rb_node, &pool->slices_busy);
 }
 
-/* find a slice by its pool offset */
+/* find a slice by its pool offset, or the run which contains the offset */
 static struct kdbus_slice *kdbus_pool_find_slice(struct kdbus_pool *pool,
 						 size_t off)
 {
+	struct kdbus_slice *below = NULL;
 	struct rb_node *n;
 
 	n = pool->slices_busy.rb_node;
@@ -159,14 +274,19 @@ static struct kdbus_slice *kdbus_pool_find_slice(struct kdbus_pool *pool,
 		struct kdbus_slice *s;
 
 		s = rb_entry(n, struct kdbus_slice, rb_node);
-		if (off < s->off)
+		if (off < s->off) {
 			n = n->rb_left;
-		else if (off > s->off)
+		} else if (off > s->off) {
+			below = s;
 			n = n->rb_right;
-		else
+		} else {
 			return s;
+		}
 	}
 
+	if (below && below->run && off < below->off + below->size)
+		return below;
+
 	return NULL;
 }
 
@@ -224,7 +344,6 @@ static int kdbus_pool_alloc_slice(struct kdbus_pool *pool,
 	}
 
 	s->free = false;
-	pool->busy += s->size;
 	*slice = s;
 	return 0;
 }
@@ -233,8 +352,11 @@ static int kdbus_pool_alloc_slice(struct kdbus_pool *pool,
 static void kdbus_pool_free_slice(struct kdbus_pool *pool,
 				  struct kdbus_slice *slice)
 {
+	unsigned int release_min = ACCESS_ONCE(kdbus_pool_release_min);
+	size_t lo = slice->off;
+	size_t hi = slice->off + slice->size;
+
 	rb_erase(&slice->rb_node, &pool->slices_busy);
-	pool->busy -= slice->size;
 
 	/* merge with the next free slice */
 	if (!list_is_last(&slice->entry, &pool->slices)) {
@@ -242,6 +364,10 @@ static void kdbus_pool_free_slice(struct kdbus_pool *pool,
 
 		s = list_entry(slice->entry.next, struct kdbus_slice, entry);
 		if (s->free) {
+			/* small free slices still have their pages */
+			if (s->size < release_min)
+				hi += s->size;
+
 			rb_erase(&s->rb_node, &pool->slices_free);
 			list_del(&s->entry);
 			slice->size += s->size;
@@ -255,6 +381,9 @@ static void kdbus_pool_free_slice(struct kdbus_pool *pool,
 
 		s = list_entry(slice->entry.prev, struct kdbus_slice, entry);
 		if (s->free) {
+			if (s->size < release_min)
+				lo = s->off;
+
 			rb_erase(&s->rb_node, &pool->slices_free);
 			list_del(&slice->entry);
 			s->size += slice->size;
@@ -265,6 +394,378 @@ static void kdbus_pool_free_slice(struct kdbus_pool *pool,
 
 	slice->free = true;
 	kdbus_pool_add_free_slice(pool, slice);
+
+	/* give the memory of large free regions back, 0 disables it */
+	if (release_min > 0 && slice->size >= release_min)
+		kdbus_pool_release(pool, lo, hi, slice->off,
+				   slice->off + slice->size);
+}
+
+/* size class of an allocation, or -1 if it is too large for a run */
+static int kdbus_pool_class(size_t size)
+{
+	if (size > KDBUS_POOL_SMALL_MAX)
+		return -1;
+
+	if (size <= (1UL << KDBUS_POOL_CLASS_SHIFT))
+		return 0;
+
+	return fls(size - 1) - KDBUS_POOL_CLASS_SHIFT;
+}
+
+static unsigned int kdbus_pool_run_objs(unsigned int class)
+{
+	return KDBUS_POOL_RUN_SIZE >> (KDBUS_POOL_CLASS_SHIFT + class);
+}
+
+/* allocate an object of the given size class from a run */
+static int kdbus_pool_alloc_small(struct kdbus_pool *pool, unsigned int class,
+				  size_t *off)
+{
+	unsigned int shift = KDBUS_POOL_CLASS_SHIFT + class;
+	unsigned int objs = kdbus_pool_run_objs(class);
+	struct kdbus_pool_run *run;
+	unsigned long bit;
+
+	run = list_first_entry_or_null(&pool->runs[class],
+				       struct kdbus_pool_run, entry);
+	if (!run) {
+		struct kdbus_slice *s;
+		int ret;
+
+		run = kzalloc(sizeof(*run), GFP_KERNEL);
+		if (!run)
+			return -ENOMEM;
+
+		ret = kdbus_pool_alloc_slice(pool, KDBUS_POOL_RUN_SIZE, &s);
+		if (ret < 0) {
+			kfree(run);
+			return ret;
+		}
+
+		s->run = run;
+		run->slice = s;
+		run->class = class;
+		list_add(&run->entry, &pool->runs[class]);
+
+		/* the whole run is taken from the pool, however full it is */
+		pool->busy += s->size;
+	}
+
+	bit = find_first_zero_bit(run->map, objs);
+	BUG_ON(bit >= objs);
+
+	__set_bit(bit, run->map);
+
+	/* full runs are not kept in the list */
+	if (++run->used == objs)
+		list_del_init(&run->entry);
+
+	*off = run->slice->off + (bit << shift);
+	return 0;
+}
+
+/* return an object back to its run */
+static int kdbus_pool_free_small(struct kdbus_pool *pool,
+				 struct kdbus_pool_run *run, size_t off)
+{
+	unsigned int shift = KDBUS_POOL_CLASS_SHIFT + run->class;
+	unsigned int objs = kdbus_pool_run_objs(run->class);
+	size_t delta = off - run->slice->off;
+	unsigned long bit = delta >> shift;
+
+	if (delta & ((1UL << shift) - 1))
+		return -ENXIO;
+
+	if (bit >= objs || !test_bit(bit, run->map))
+		return -ENXIO;
+
+	__clear_bit(bit, run->map);
+
+	if (run->used-- == objs)
+		list_add(&run->entry, &pool->runs[run->class]);
+
+	/* keep one empty run per class around, release all others */
+	if (run->used == 0 && !list_is_singular(&pool->runs[run->class])) {
+		list_del(&run->entry);
+		pool->busy -= run->slice->size;
+		run->slice->run = NULL;
+		kdbus_pool_free_slice(pool, run->slice);
+		kfree(run);
+	}
+
+	return 0;
+}
+
+static struct kdbus_pool_fifo_rec *
+kdbus_pool_fifo_rec(const struct kdbus_pool_fifo *fifo, unsigned int i)
+{
+	return &fifo->recs[(fifo->first + i) & (fifo->n_recs - 1)];
+}
+
+/* allocate from the ring buffer */
+static int kdbus_pool_fifo_alloc(struct kdbus_pool *pool, size_t size,
+				 size_t *off)
+{
+	struct kdbus_pool_fifo *fifo = pool->fifo;
+	struct kdbus_pool_fifo_rec *rec;
+	size_t tail;
+	size_t o;
+
+	/* zero-sized allocations need a distinct offset too */
+	size = max_t(size_t, KDBUS_ALIGN8(size), 8);
+
+	if (fifo->count == 0) {
+		if (size > pool->size)
+			return -ENOBUFS;
+
+		o = 0;
+	} else {
+		tail = kdbus_pool_fifo_rec(fifo, 0)->off;
+
+		if (fifo->head > tail) {
+			/* not wrapped, use the end or wrap around */
+			if (fifo->head + size <= pool->size)
+				o = fifo->head;
+			else if (size <= tail)
+				o = 0;
+			else
+				return -ENOBUFS;
+		} else {
+			/* wrapped, the space up to the tail is free */
+			if (fifo->head + size <= tail)
+				o = fifo->head;
+			else
+				return -ENOBUFS;
+		}
+	}
+
+	if (fifo->count == fifo->n_recs) {
+		struct kdbus_pool_fifo_rec *recs;
+		unsigned int i;
+
+		recs = kmalloc(2 * fifo->n_recs * sizeof(*recs), GFP_KERNEL);
+		if (!recs)
+			return -ENOMEM;
+
+		for (i = 0; i < fifo->count; i++)
+			recs[i] = *kdbus_pool_fifo_rec(fifo, i);
+
+		kfree(fifo->recs);
+		fifo->recs = recs;
+		fifo->n_recs *= 2;
+		fifo->first = 0;
+	}
+
+	rec = kdbus_pool_fifo_rec(fifo, fifo->count++);
+	rec->off = o;
+	rec->size = size;
+
+	fifo->head = o + size;
+	pool->busy += size;
+	*off = o;
+
+	return 0;
+}
+
+/*
+ * Free from the ring buffer. Only the oldest allocation, or the most
+ * recent one to undo a failed operation, can be freed; returns -EAGAIN if
+ * @off is any other allocation.
+ */
+static int kdbus_pool_fifo_free(struct kdbus_pool *pool, size_t off)
+{
+	struct kdbus_pool_fifo *fifo = pool->fifo;
+	struct kdbus_pool_fifo_rec *rec;
+	unsigned int i;
+
+	if (fifo->count == 0)
+		return -ENXIO;
+
+	rec = kdbus_pool_fifo_rec(fifo, 0);
+	if (rec->off == off) {
+		unsigned int release_min = ACCESS_ONCE(kdbus_pool_release_min);
+
+		if (release_min > 0 && rec->size >= release_min)
+			kdbus_pool_release(pool, rec->off, rec->off + rec->size,
+					   rec->off, rec->off + rec->size);
+
+		fifo->first = (fifo->first + 1) & (fifo->n_recs - 1);
+		fifo->count--;
+		goto exit_freed;
+	}
+
+	rec = kdbus_pool_fifo_rec(fifo, fifo->count - 1);
+	if (rec->off == off) {
+		fifo->count--;
+		fifo->head = off;
+		goto exit_freed;
+	}
+
+	for (i = 1; i < fifo->count - 1; i++)
+		if (kdbus_pool_fifo_rec(fifo, i)->off == off)
+			return -EAGAIN;
+
+	return -ENXIO;
+
+exit_freed:
+	pool->busy -= rec->size;
+
+	/* start over at the beginning of the pool when it is empty */
+	if (fifo->count == 0)
+		fifo->head = 0;
+
+	return 0;
+}
+
+/*
+ * Leave FIFO mode: replace the single free slice, which spans the pool
+ * while the ring buffer is in use, with busy slices for all live
+ * allocations and free slices for the gaps between them.
+ */
+static int kdbus_pool_fifo_to_slices(struct kdbus_pool *pool)
+{
+	struct kdbus_pool_fifo *fifo = pool->fifo;
+	struct kdbus_slice *s, *tmp;
+	unsigned int wrap, i;
+	LIST_HEAD(slices);
+	size_t pos = 0;
+
+	/* the records are in address order, except for one wrap-around */
+	for (wrap = 1; wrap < fifo->count; wrap++)
+		if (kdbus_pool_fifo_rec(fifo, wrap)->off <
+		    kdbus_pool_fifo_rec(fifo, wrap - 1)->off)
+			break;
+
+	for (i = 0; i < fifo->count; i++) {
+		struct kdbus_pool_fifo_rec *rec;
+
+		rec = kdbus_pool_fifo_rec(fifo, (wrap + i) % fifo->count);
+
+		if (rec->off > pos) {
+			s = kdbus_pool_slice_new(pos, rec->off - pos);
+			if (!s)
+				goto exit_free;
+
+			list_add_tail(&s->entry, &slices);
+		}
+
+		s = kdbus_pool_slice_new(rec->off, rec->size);
+		if (!s)
+			goto exit_free;
+
+		s->free = false;
+		list_add_tail(&s->entry, &slices);
+		pos = rec->off + rec->size;
+	}
+
+	if (pos < pool->size) {
+		s = kdbus_pool_slice_new(pos, pool->size - pos);
+		if (!s)
+			goto exit_free;
+
+		list_add_tail(&s->entry, &slices);
+	}
+
+	list_for_each_entry_safe(s, tmp, &pool->slices, entry) {
+		list_del(&s->entry);
+		kfree(s);
+	}
+
+	list_splice(&slices, &pool->slices);
+	pool->slices_free = RB_ROOT;
+	pool->slices_busy = RB_ROOT;
+
+	list_for_each_entry(s, &pool->slices, entry) {
+		if (s->free)
+			kdbus_pool_add_free_slice(pool, s);
+		else
+			kdbus_pool_add_busy_slice(pool, s);
+	}
+
+	kfree(fifo->recs);
+	kfree(fifo);
+	pool->fifo = NULL;
+
+	return 0;
+
+exit_free:
+	list_for_each_entry_safe(s, tmp, &slices, entry) {
+		list_del(&s->entry);
+		kfree(s);
+	}
+
+	return -ENOMEM;
+}
+
+/* drop the kernel mapping of the pool and release its pages */
+static void kdbus_pool_unmap(struct kdbus_pool *pool)
+{
+	size_t i;
+
+	if (!pool->pages)
+		return;
+
+	if (pool->kaddr)
+		vunmap(pool->kaddr);
+
+	for (i = 0; i < pool->size >> PAGE_SHIFT; i++)
+		if (pool->pages[i])
+			page_cache_release(pool->pages[i]);
+
+	vfree(pool->pages);
+	pool->pages = NULL;
+	pool->kaddr = NULL;
+}
+
+/*
+ * Populate all pages of the pool, take a reference to keep them in the
+ * shmem file, and map them into the kernel's address space, so messages can
+ * be copied with plain memcpy() and copy_from_user().
+ */
+static int kdbus_pool_map(struct kdbus_pool *pool)
+{
+	struct address_space *mapping = pool->f->f_mapping;
+	size_t n = pool->size >> PAGE_SHIFT;
+	size_t i;
+	int ret;
+
+	pool->pages = vzalloc(n * sizeof(struct page *));
+	if (!pool->pages)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		struct page *p;
+
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			goto exit_unmap;
+		}
+
+		p = shmem_read_mapping_page(mapping, i);
+		if (IS_ERR(p)) {
+			ret = PTR_ERR(p);
+			goto exit_unmap;
+		}
+
+		/* we write to the page behind the back of the page cache */
+		set_page_dirty(p);
+		pool->pages[i] = p;
+
+		cond_resched();
+	}
+
+	pool->kaddr = vmap(pool->pages, n, VM_MAP, PAGE_KERNEL);
+	if (!pool->kaddr) {
+		ret = -ENOMEM;
+		goto exit_unmap;
+	}
+
+	return 0;
+
+exit_unmap:
+	kdbus_pool_unmap(pool);
+	return ret;
 }
 
 /**
@@ -272,15 +773,21 @@ static void kdbus_pool_free_slice(struct kdbus_pool *pool,
  * @name:		Name of the (deleted) file which shows up in
  *			/proc, used for debugging
  * @size:		Maximum size of the pool
+ * @flags:		KDBUS_POOL_* flags
  * @pool:		Newly allocated pool
  *
+ * A pool in FIFO mode falls back to the slice allocator as soon as an
+ * allocation other than the oldest one is freed.
+ *
  * Return: 0 on success, negative errno on failure.
  */
-int kdbus_pool_new(const char *name, size_t size, struct kdbus_pool **pool)
+int kdbus_pool_new(const char *name, size_t size, unsigned int flags,
+		   struct kdbus_pool **pool)
 {
 	struct kdbus_pool *p;
 	struct file *f;
 	struct kdbus_slice *s;
+	unsigned int i;
 	int ret;
 
 	BUG_ON(*pool);
@@ -314,6 +821,23 @@ int kdbus_pool_new(const char *name, size_t size, struct kdbus_pool **pool)
 		goto exit_put_shmem;
 	}
 
+	if (flags & KDBUS_POOL_FIFO) {
+		p->fifo = kzalloc(sizeof(*p->fifo), GFP_KERNEL);
+		if (!p->fifo) {
+			ret = -ENOMEM;
+			goto exit_free_slice;
+		}
+
+		p->fifo->n_recs = KDBUS_POOL_FIFO_RECS;
+		p->fifo->recs = kmalloc(KDBUS_POOL_FIFO_RECS *
+					sizeof(struct kdbus_pool_fifo_rec),
+					GFP_KERNEL);
+		if (!p->fifo->recs) {
+			ret = -ENOMEM;
+			goto exit_free_fifo;
+		}
+	}
+
 	p->f = f;
 	p->size = size;
 	p->busy = 0;
@@ -321,6 +845,15 @@ int kdbus_pool_new(const char *name, size_t size, struct kdbus_pool **pool)
 	p->slices_busy = RB_ROOT;
 	mutex_init(&p->lock);
 
+	for (i = 0; i < KDBUS_POOL_CLASSES; i++)
+		INIT_LIST_HEAD(&p->runs[i]);
+
+	if (flags & KDBUS_POOL_MAPPED) {
+		ret = kdbus_pool_map(p);
+		if (ret < 0)
+			goto exit_free_recs;
+	}
+
 	INIT_LIST_HEAD(&p->slices);
 	list_add(&s->entry, &p->slices);
 
@@ -328,6 +861,13 @@ int kdbus_pool_new(const char *name, size_t size, struct kdbus_pool **pool)
 	*pool = p;
 	return 0;
 
+exit_free_recs:
+	if (p->fifo)
+		kfree(p->fifo->recs);
+exit_free_fifo:
+	kfree(p->fifo);
+exit_free_slice:
+	kfree(s);
 exit_put_shmem:
 	fput(f);
 exit_free:
@@ -348,13 +888,32 @@ void kdbus_pool_free(struct kdbus_pool *pool)
 
 	list_for_each_entry_safe(s, tmp, &pool->slices, entry) {
 		list_del(&s->entry);
+		kfree(s->run);
 		kfree(s);
 	}
 
+	if (pool->fifo) {
+		kfree(pool->fifo->recs);
+		kfree(pool->fifo);
+	}
+
+	kdbus_pool_unmap(pool);
+
 	fput(pool->f);
 	kfree(pool);
 }
 
+/**
+ * kdbus_pool_size() - the size of the pool
+ * @pool:		The receiver's pool
+ *
+ * Return: the size of the pool in bytes
+ */
+size_t kdbus_pool_size(const struct kdbus_pool *pool)
+{
+	return pool->size;
+}
+
 /**
  * kdbus_pool_remain() - the number of free bytes in the pool
  * @pool:		The receiver's pool
@@ -387,16 +946,34 @@ size_t kdbus_pool_remain(struct kdbus_pool *pool)
 int kdbus_pool_alloc_range(struct kdbus_pool *pool, size_t size, size_t *off)
 {
 	struct kdbus_slice *s;
+	int class;
 	int ret;
 
 	mutex_lock(&pool->lock);
+	if (pool->fifo) {
+		ret = kdbus_pool_fifo_alloc(pool, size, off);
+		goto exit_unlock;
+	}
+
+	class = kdbus_pool_class(KDBUS_ALIGN8(size));
+	if (class >= 0) {
+		ret = kdbus_pool_alloc_small(pool, class, off);
+		if (ret == 0)
+			goto exit_unlock;
+
+		/* no room for a new run, try the slice allocator */
+	}
+
 	ret = kdbus_pool_alloc_slice(pool, size, &s);
-	mutex_unlock(&pool->lock);
 	if (ret < 0)
-		return ret;
+		goto exit_unlock;
 
+	pool->busy += s->size;
 	*off = s->off;
-	return 0;
+
+exit_unlock:
+	mutex_unlock(&pool->lock);
+	return ret;
 }
 
 /**
@@ -423,12 +1000,29 @@ int kdbus_pool_free_range(struct kdbus_pool *pool, size_t off)
 		goto exit_unlock;
 	}
 
+	if (pool->fifo) {
+		ret = kdbus_pool_fifo_free(pool, off);
+		if (ret != -EAGAIN)
+			goto exit_unlock;
+
+		/* freed out of order, switch to the slice allocator */
+		ret = kdbus_pool_fifo_to_slices(pool);
+		if (ret < 0)
+			goto exit_unlock;
+	}
+
 	slice = kdbus_pool_find_slice(pool, off);
 	if (!slice) {
 		ret = -ENXIO;
 		goto exit_unlock;
 	}
 
+	if (slice->run) {
+		ret = kdbus_pool_free_small(pool, slice->run, off);
+		goto exit_unlock;
+	}
+
+	pool->busy -= slice->size;
 	kdbus_pool_free_slice(pool, slice);
 
 exit_unlock:
@@ -436,21 +1030,40 @@ exit_unlock:
 	return ret;
 }
 
-/* copy data from a file to ia page in the receiver's pool */
+/*
+ * Copy data from another pool's shmem file to a page in the receiver's
+ * pool. The source pages are copied directly, without going through the
+ * file's read() and the user copy it implies.
+ */
 static int kdbus_pool_copy_file(struct page *p, size_t start,
 				struct file *f, size_t off, size_t count)
 {
-	char *kaddr;
-	ssize_t n;
-	loff_t o = off;
-
-	kaddr = kmap(p);
-	n = f->f_op->read(f, (char __force __user *)kaddr + start, count, &o);
-	kunmap(p);
-	if (n < 0)
-		return n;
-	if (n != count)
-		return -EFAULT;
+	struct address_space *mapping = f->f_mapping;
+
+	while (count > 0) {
+		struct page *sp;
+		char *saddr, *kaddr;
+		size_t o, n;
+
+		o = off & ~PAGE_CACHE_MASK;
+		n = min_t(size_t, PAGE_CACHE_SIZE - o, count);
+
+		/* brings back swapped-out pages */
+		sp = shmem_read_mapping_page(mapping, off >> PAGE_CACHE_SHIFT);
+		if (IS_ERR(sp))
+			return PTR_ERR(sp);
+
+		kaddr = kmap_atomic(p);
+		saddr = kmap_atomic(sp);
+		memcpy(kaddr + start, saddr + o, n);
+		kunmap_atomic(saddr);
+		kunmap_atomic(kaddr);
+		page_cache_release(sp);
+
+		start += n;
+		off += n;
+		count -= n;
+	}
 
 	return 0;
 }
@@ -510,7 +1123,8 @@ kdbus_pool_copy(struct file *f_dst, size_t off_dst,
 		if (data)
 			ret = kdbus_pool_copy_data(p, o, data + dpos, n);
 		else
-			ret = kdbus_pool_copy_file(p, o, f_src, off_src, n);
+			ret = kdbus_pool_copy_file(p, o, f_src,
+						   off_src + dpos, n);
 		mark_page_accessed(p);
 
 		status = aops->write_end(f_dst, mapping, fpos, n, n, p, fsdata);
@@ -546,6 +1160,14 @@ kdbus_pool_copy(struct file *f_dst, size_t off_dst,
 ssize_t kdbus_pool_write_user(const struct kdbus_pool *pool, size_t off,
 			      void __user *data, size_t len)
 {
+	if (pool->kaddr) {
+		if (copy_from_user(pool->kaddr + off, data, len))
+			return -EFAULT;
+
+		flush_kernel_vmap_range(pool->kaddr + off, len);
+		return 0;
+	}
+
 	return kdbus_pool_copy(pool->f, off, data, NULL, 0, len);
 }
 
@@ -568,6 +1190,12 @@ ssize_t kdbus_pool_write(const struct kdbus_pool *pool, size_t off,
 	mm_segment_t old_fs;
 	ssize_t ret;
 
+	if (pool->kaddr) {
+		memcpy(pool->kaddr + off, data, len);
+		flush_kernel_vmap_range(pool->kaddr + off, len);
+		return 0;
+	}
+
 	old_fs = get_fs();
 	set_fs(get_ds());
 	ret = kdbus_pool_copy(pool->f, off, (void __user *)data, NULL, 0, len);
@@ -577,7 +1205,7 @@ ssize_t kdbus_pool_write(const struct kdbus_pool *pool, size_t off,
 }
 
 /**
- * kdbus_pool_write() - move memory from one pool into another one
+ * kdbus_pool_move() - move memory from one pool into another one
  * @dst_pool:		The receiver's pool to copy to
  * @src_pool:		The receiver's pool to copy from
  * @off:		Offset of allocated memory in the source pool,
@@ -594,7 +1222,6 @@ int kdbus_pool_move(struct kdbus_pool *dst_pool,
 		    struct kdbus_pool *src_pool,
 		    size_t *off, size_t len)
 {
-	mm_segment_t old_fs;
 	size_t new_off;
 	int ret;
 
@@ -602,11 +1229,8 @@ int kdbus_pool_move(struct kdbus_pool *dst_pool,
 	if (ret < 0)
 		return ret;
 
-	old_fs = get_fs();
-	set_fs(get_ds());
 	ret = kdbus_pool_copy(dst_pool->f, new_off,
 			      NULL, src_pool->f, *off, len);
-	set_fs(old_fs);
 	if (ret < 0)
 		goto exit_free;
 
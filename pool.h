@@ -15,11 +15,25 @@
 
 struct kdbus_pool;
 
-int kdbus_pool_new(const char *name, size_t size, struct kdbus_pool **pool);
+/**
+ * enum kdbus_pool_flags - flags for kdbus_pool_new()
+ * @KDBUS_POOL_FIFO:	Use the pool as a ring buffer, for receivers which
+ *			free their messages in the order of arrival
+ * @KDBUS_POOL_MAPPED:	Populate the pool at creation time, and keep a kernel
+ *			mapping of it to copy messages to
+ */
+enum kdbus_pool_flags {
+	KDBUS_POOL_FIFO		= 1 << 0,
+	KDBUS_POOL_MAPPED	= 1 << 1,
+};
+
+int kdbus_pool_new(const char *name, size_t size, unsigned int flags,
+		   struct kdbus_pool **pool);
 void kdbus_pool_free(struct kdbus_pool *pool);
 
 int kdbus_pool_alloc_range(struct kdbus_pool *pool, size_t size, size_t *off);
 int kdbus_pool_free_range(struct kdbus_pool *pool, size_t off);
+size_t kdbus_pool_size(const struct kdbus_pool *pool);
 size_t kdbus_pool_remain(struct kdbus_pool *pool);
 ssize_t kdbus_pool_write(const struct kdbus_pool *pool, size_t off,
 			 void *data, size_t len);
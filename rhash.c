@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2013 Kay Sievers
+ * Copyright (C) 2013 Greg Kroah-Hartman <gregkh@linuxfoundation.org>
+ * Copyright (C) 2013 Daniel Mack <daniel@zonque.org>
+ * Copyright (C) 2013 Linux Foundation
+ *
+ * kdbus is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ */
+
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include "rhash.h"
+
+/* bounds of the table size, in bits */
+#define KDBUS_RHASH_BITS_MIN	8
+#define KDBUS_RHASH_BITS_MAX	20
+
+static struct kdbus_rhash_table *kdbus_rhash_table_new(unsigned int bits,
+						       unsigned int idx)
+{
+	struct kdbus_rhash_table *t;
+	size_t size;
+
+	size = sizeof(*t) + (sizeof(struct hlist_head) << bits);
+	if (size > PAGE_SIZE)
+		t = vzalloc(size);
+	else
+		t = kzalloc(size, GFP_KERNEL);
+	if (!t)
+		return NULL;
+
+	t->bits = bits;
+	t->idx = idx;
+
+	return t;
+}
+
+static void kdbus_rhash_table_free(struct kdbus_rhash_table *t)
+{
+	if (is_vmalloc_addr(t))
+		vfree(t);
+	else
+		kfree(t);
+}
+
+static void kdbus_rhash_table_free_rcu(struct rcu_head *rcu)
+{
+	struct kdbus_rhash_table *t =
+		container_of(rcu, struct kdbus_rhash_table, rcu);
+
+	ACCESS_ONCE(t->rhash->table_old) = false;
+	kdbus_rhash_table_free(t);
+}
+
+/*
+ * Move all entries to new buckets of the given size. Readers may still
+ * walk the old buckets until a grace period has passed, so they are freed
+ * with RCU, and the table is not resized again before that, as it would
+ * reuse the hlist nodes of the old buckets. If the resize is skipped or no
+ * memory is available, the buckets stay in place, which only costs speed.
+ */
+static void kdbus_rhash_resize(struct kdbus_rhash *h, unsigned int bits)
+{
+	struct kdbus_rhash_table *old = kdbus_rhash_table(h);
+	struct kdbus_rhash_node *n;
+	struct kdbus_rhash_table *t;
+	unsigned int i;
+
+	if (ACCESS_ONCE(h->table_old))
+		return;
+
+	t = kdbus_rhash_table_new(bits, !old->idx);
+	if (!t)
+		return;
+
+	for (i = 0; i < (1U << old->bits); i++)
+		hlist_for_each_entry(n, &old->buckets[i], node[old->idx])
+			hlist_add_head_rcu(&n->node[t->idx],
+					   kdbus_rhash_bucket(t, n->hash));
+
+	rcu_assign_pointer(h->table, t);
+
+	h->table_old = true;
+	old->rhash = h;
+	call_rcu(&old->rcu, kdbus_rhash_table_free_rcu);
+}
+
+/**
+ * kdbus_rhash_init() - initialize a resizable hash table
+ * @h:			The hash table
+ * @lock:		The lock the writers of the table hold
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int kdbus_rhash_init(struct kdbus_rhash *h, struct mutex *lock)
+{
+	h->table = kdbus_rhash_table_new(KDBUS_RHASH_BITS_MIN, 0);
+	if (!h->table)
+		return -ENOMEM;
+
+	h->count = 0;
+	h->table_old = false;
+	h->lock = lock;
+
+	return 0;
+}
+
+/**
+ * kdbus_rhash_destroy() - free the buckets of a hash table
+ * @h:			The hash table
+ *
+ * The entries are not touched; there must not be any readers left.
+ */
+void kdbus_rhash_destroy(struct kdbus_rhash *h)
+{
+	/* replaced buckets still refer to the table */
+	if (ACCESS_ONCE(h->table_old))
+		rcu_barrier();
+
+	kdbus_rhash_table_free(rcu_dereference_raw(h->table));
+}
+
+/**
+ * kdbus_rhash_add() - add an entry to a hash table
+ * @h:			The hash table
+ * @n:			The node of the entry
+ * @hash:		The hash of the entry's key
+ *
+ * The table grows when its chains get longer than one entry on average.
+ * This function must be called with the lock of the writers held.
+ */
+void kdbus_rhash_add(struct kdbus_rhash *h, struct kdbus_rhash_node *n,
+		     u32 hash)
+{
+	struct kdbus_rhash_table *t = kdbus_rhash_table(h);
+
+	n->hash = hash;
+	hlist_add_head_rcu(&n->node[t->idx], kdbus_rhash_bucket(t, hash));
+	h->count++;
+
+	if (h->count > (1U << t->bits) && t->bits < KDBUS_RHASH_BITS_MAX)
+		kdbus_rhash_resize(h, t->bits + 1);
+}
+
+/**
+ * kdbus_rhash_del() - remove an entry from a hash table
+ * @h:			The hash table
+ * @n:			The node of the entry
+ *
+ * The entry stays valid for lookups under RCU which still found it, it
+ * must only be freed after a grace period. This function must be called
+ * with the lock of the writers held.
+ */
+void kdbus_rhash_del(struct kdbus_rhash *h, struct kdbus_rhash_node *n)
+{
+	struct kdbus_rhash_table *t = kdbus_rhash_table(h);
+
+	hlist_del_rcu(&n->node[t->idx]);
+	h->count--;
+
+	/* shrink only well below the growth point, to not flip-flop */
+	if (h->count < (1U << t->bits) / 4 && t->bits > KDBUS_RHASH_BITS_MIN)
+		kdbus_rhash_resize(h, t->bits - 1);
+}
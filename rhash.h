@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2013 Kay Sievers
+ * Copyright (C) 2013 Greg Kroah-Hartman <gregkh@linuxfoundation.org>
+ * Copyright (C) 2013 Daniel Mack <daniel@zonque.org>
+ * Copyright (C) 2013 Linux Foundation
+ *
+ * kdbus is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ */
+
+#ifndef __KDBUS_RHASH_H
+#define __KDBUS_RHASH_H
+
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+
+/**
+ * struct kdbus_rhash_node - entry of a resizable hash table
+ * @node:		The hlist nodes; the current table uses one of them,
+ *			a resized table is built with the other
+ * @hash:		The hash of the entry's key
+ */
+struct kdbus_rhash_node {
+	struct hlist_node	node[2];
+	u32			hash;
+};
+
+/**
+ * struct kdbus_rhash_table - the buckets of a resizable hash table
+ * @bits:		Number of bits of the bucket index
+ * @idx:		Index of the hlist node in the entries used by this
+ *			table
+ * @rhash:		The hash table, set when the buckets are replaced
+ * @rcu:		RCU head, replaced buckets are freed after a grace
+ *			period
+ * @buckets:		The buckets
+ */
+struct kdbus_rhash_table {
+	unsigned int		bits;
+	unsigned int		idx;
+	struct kdbus_rhash	*rhash;
+	struct rcu_head		rcu;
+	struct hlist_head	buckets[0];
+};
+
+/**
+ * struct kdbus_rhash - hash table which grows and shrinks with its entries
+ * @table:		The buckets, looked up under RCU
+ * @count:		Number of entries
+ * @table_old:		Replaced buckets are waiting for their grace period
+ * @lock:		The lock of the writers, held by the owner of the
+ *			table around kdbus_rhash_add() and kdbus_rhash_del()
+ *
+ * The buckets are replaced when the number of entries grows or shrinks
+ * too far. The entries are linked into the new buckets through their other
+ * hlist node, so lookups under RCU can still walk the old buckets while
+ * the new ones are built.
+ */
+struct kdbus_rhash {
+	struct kdbus_rhash_table __rcu *table;
+	unsigned int		count;
+	bool			table_old;
+	struct mutex		*lock;
+};
+
+int kdbus_rhash_init(struct kdbus_rhash *h, struct mutex *lock);
+void kdbus_rhash_destroy(struct kdbus_rhash *h);
+void kdbus_rhash_add(struct kdbus_rhash *h, struct kdbus_rhash_node *n,
+		     u32 hash);
+void kdbus_rhash_del(struct kdbus_rhash *h, struct kdbus_rhash_node *n);
+
+/* the buckets of a table, with the lock of the writers held */
+static inline struct kdbus_rhash_table *
+kdbus_rhash_table(const struct kdbus_rhash *h)
+{
+	return rcu_dereference_protected(h->table, lockdep_is_held(h->lock));
+}
+
+static inline struct hlist_head *
+kdbus_rhash_bucket(struct kdbus_rhash_table *t, u32 hash)
+{
+	return &t->buckets[hash_32(hash, t->bits)];
+}
+
+/**
+ * kdbus_rhash_for_each_possible - iterate over the entries of a bucket
+ * @_t:			The buckets, from kdbus_rhash_table()
+ * @_obj:		The type * to use as a loop cursor
+ * @_member:		The name of the struct kdbus_rhash_node in @_obj
+ * @_hash:		The hash of the key to look up
+ */
+#define kdbus_rhash_for_each_possible(_t, _obj, _member, _hash)		\
+	hlist_for_each_entry(_obj, kdbus_rhash_bucket(_t, _hash),		\
+			     _member.node[(_t)->idx])
+
+/**
+ * kdbus_rhash_for_each_possible_rcu - iterate over a bucket under RCU
+ * @_t:			The buckets, from rcu_dereference() of the table
+ * @_obj:		The type * to use as a loop cursor
+ * @_member:		The name of the struct kdbus_rhash_node in @_obj
+ * @_hash:		The hash of the key to look up
+ */
+#define kdbus_rhash_for_each_possible_rcu(_t, _obj, _member, _hash)	\
+	hlist_for_each_entry_rcu(_obj, kdbus_rhash_bucket(_t, _hash),	\
+				 _member.node[(_t)->idx])
+
+/**
+ * kdbus_rhash_for_each_safe - iterate over all entries, which may be freed
+ * @_t:			The buckets, from kdbus_rhash_table()
+ * @_i:			An unsigned int to use as the bucket index
+ * @_tmp:		A struct hlist_node * to use as temporary storage
+ * @_obj:		The type * to use as a loop cursor
+ * @_member:		The name of the struct kdbus_rhash_node in @_obj
+ *
+ * Meant to tear down a table; the entries must not be removed with
+ * kdbus_rhash_del(), which may replace the buckets being walked.
+ */
+#define kdbus_rhash_for_each_safe(_t, _i, _tmp, _obj, _member)		\
+	for (_i = 0; _i < (1U << (_t)->bits); _i++)			\
+		hlist_for_each_entry_safe(_obj, _tmp, &(_t)->buckets[_i], \
+					  _member.node[(_t)->idx])
+#endif
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2013 Kay Sievers
+ * Copyright (C) 2013 Greg Kroah-Hartman <gregkh@linuxfoundation.org>
+ * Copyright (C) 2013 Daniel Mack <daniel@zonque.org>
+ * Copyright (C) 2013 Linux Foundation
+ *
+ * kdbus is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ */
+
+#include <linux/cache.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include "defaults.h"
+#include "ring.h"
+#include "util.h"
+
+/*
+ * Layout of the shared memory: the indices of the submission and the
+ * completion ring in separate cache lines, followed by the entries of the
+ * submission ring, followed by the entries of the completion ring.
+ */
+#define KDBUS_RING_SQ_OFF	0
+#define KDBUS_RING_CQ_OFF	SMP_CACHE_BYTES
+#define KDBUS_RING_SQES_OFF	(2 * SMP_CACHE_BYTES)
+
+static size_t kdbus_ring_cqes_off(unsigned int entries)
+{
+	return KDBUS_RING_SQES_OFF + entries * sizeof(struct kdbus_ring_sqe);
+}
+
+/**
+ * kdbus_ring_new() - create a new pair of rings
+ * @entries:		The number of entries of each ring
+ * @ring:		The returned ring
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_ring_new(unsigned int entries, struct kdbus_ring **ring)
+{
+	struct kdbus_ring *r;
+
+	if (entries == 0 || entries > KDBUS_RING_MAX_ENTRIES ||
+	    !is_power_of_2(entries))
+		return -EINVAL;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	r->size = PAGE_ALIGN(kdbus_ring_cqes_off(entries) +
+			     entries * sizeof(struct kdbus_ring_cqe));
+
+	/* zeroed memory, which can be mapped to userspace */
+	r->mem = vmalloc_user(r->size);
+	if (!r->mem) {
+		kfree(r);
+		return -ENOMEM;
+	}
+
+	mutex_init(&r->lock);
+	r->entries = entries;
+	r->sq = r->mem + KDBUS_RING_SQ_OFF;
+	r->sqes = r->mem + KDBUS_RING_SQES_OFF;
+	r->cq = r->mem + KDBUS_RING_CQ_OFF;
+	r->cqes = r->mem + kdbus_ring_cqes_off(entries);
+
+	*ring = r;
+	return 0;
+}
+
+/**
+ * kdbus_ring_free() - destroy a pair of rings
+ * @ring:		The ring to destroy (may be NULL)
+ */
+void kdbus_ring_free(struct kdbus_ring *ring)
+{
+	if (!ring)
+		return;
+
+	vfree(ring->mem);
+	kfree(ring);
+}
+
+/**
+ * kdbus_ring_layout() - describe the shared memory of the rings
+ * @ring:		The ring
+ * @cmd:		The command to store the layout in
+ *
+ * The mmap() offset is not known to the ring and is left untouched.
+ */
+void kdbus_ring_layout(const struct kdbus_ring *ring,
+		       struct kdbus_cmd_ring *cmd)
+{
+	cmd->entries = ring->entries;
+	cmd->size = ring->size;
+	cmd->sq_off = KDBUS_RING_SQ_OFF;
+	cmd->sqes_off = KDBUS_RING_SQES_OFF;
+	cmd->cq_off = KDBUS_RING_CQ_OFF;
+	cmd->cqes_off = kdbus_ring_cqes_off(ring->entries);
+}
+
+/**
+ * kdbus_ring_mmap() -  map the rings into the caller's address space
+ * @ring:		The ring
+ * @vma:		The memory area to map the rings into
+ *
+ * Unlike the pool, the rings are mapped writable.
+ *
+ * Return: 0 on success, negative errno on failure
+ */
+int kdbus_ring_mmap(const struct kdbus_ring *ring, struct vm_area_struct *vma)
+{
+	if ((vma->vm_end - vma->vm_start) > ring->size)
+		return -EFAULT;
+
+	return remap_vmalloc_range(vma, ring->mem, 0);
+}
+
+/**
+ * kdbus_ring_sqe_get() - consume the next entry of the submission ring
+ * @ring:		The ring
+ * @sqe:		The returned copy of the entry
+ *
+ * An entry is only consumed if there is room in the completion ring to post
+ * its result. The entry is copied, so userspace cannot modify it while it
+ * is processed. The caller must hold the ring lock.
+ *
+ * Return: true if an entry was consumed, false otherwise
+ */
+bool kdbus_ring_sqe_get(struct kdbus_ring *ring, struct kdbus_ring_sqe *sqe)
+{
+	u64 tail, head;
+
+	tail = ACCESS_ONCE(ring->sq->tail);
+	if (tail == ring->sq_head)
+		return false;
+
+	/* a tail further away than the size of the ring is invalid */
+	if (tail - ring->sq_head > ring->entries)
+		return false;
+
+	/* completion ring is full */
+	head = ACCESS_ONCE(ring->cq->head);
+	if (ring->cq_tail - head >= ring->entries)
+		return false;
+
+	/* read the entry only after we have seen the tail */
+	smp_rmb();
+	*sqe = ring->sqes[ring->sq_head & (ring->entries - 1)];
+
+	/* hand the slot back to userspace only after we copied it */
+	smp_mb();
+	ring->sq_head++;
+	ACCESS_ONCE(ring->sq->head) = ring->sq_head;
+
+	return true;
+}
+
+/**
+ * kdbus_ring_cqe_post() - produce an entry in the completion ring
+ * @ring:		The ring
+ * @user_data:		The user data of the submission ring entry
+ * @result:		The result of the operation
+ * @offset:		The pool offset of a received message
+ *
+ * The caller must hold the ring lock, and must have checked for room with
+ * kdbus_ring_sqe_get().
+ */
+void kdbus_ring_cqe_post(struct kdbus_ring *ring, u64 user_data,
+			 s64 result, u64 offset)
+{
+	struct kdbus_ring_cqe *cqe;
+
+	cqe = &ring->cqes[ring->cq_tail & (ring->entries - 1)];
+	cqe->user_data = user_data;
+	cqe->result = result;
+	cqe->offset = offset;
+
+	/* make the entry visible before the tail */
+	smp_wmb();
+	ring->cq_tail++;
+	ACCESS_ONCE(ring->cq->tail) = ring->cq_tail;
+}
+
+/**
+ * kdbus_ring_cq_pending() - check for unconsumed completion ring entries
+ * @ring:		The ring
+ *
+ * Return: true if userspace has not consumed all completion ring entries
+ */
+bool kdbus_ring_cq_pending(const struct kdbus_ring *ring)
+{
+	return ACCESS_ONCE(ring->cq->head) != ACCESS_ONCE(ring->cq_tail);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2013 Kay Sievers
+ * Copyright (C) 2013 Greg Kroah-Hartman <gregkh@linuxfoundation.org>
+ * Copyright (C) 2013 Daniel Mack <daniel@zonque.org>
+ * Copyright (C) 2013 Linux Foundation
+ *
+ * kdbus is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ */
+
+#ifndef __KDBUS_RING_H
+#define __KDBUS_RING_H
+
+#include "kdbus.h"
+
+/**
+ * struct kdbus_ring - submission and completion rings of a connection
+ * @lock:		Serializes the consumers of the submission ring
+ * @mem:		The memory shared with userspace
+ * @size:		The size of @mem
+ * @entries:		The number of entries of each ring
+ * @sq:			Indices of the submission ring
+ * @sqes:		Entries of the submission ring
+ * @sq_head:		Private copy of the submission ring head
+ * @cq:			Indices of the completion ring
+ * @cqes:		Entries of the completion ring
+ * @cq_tail:		Private copy of the completion ring tail
+ *
+ * The indices owned by the kernel are kept in private copies, and are
+ * only ever written to the shared memory, never read back from it.
+ */
+struct kdbus_ring {
+	struct mutex lock;
+	void *mem;
+	size_t size;
+	unsigned int entries;
+	struct kdbus_ring_ctl *sq;
+	struct kdbus_ring_sqe *sqes;
+	u64 sq_head;
+	struct kdbus_ring_ctl *cq;
+	struct kdbus_ring_cqe *cqes;
+	u64 cq_tail;
+};
+
+int kdbus_ring_new(unsigned int entries, struct kdbus_ring **ring);
+void kdbus_ring_free(struct kdbus_ring *ring);
+void kdbus_ring_layout(const struct kdbus_ring *ring,
+		       struct kdbus_cmd_ring *cmd);
+int kdbus_ring_mmap(const struct kdbus_ring *ring,
+		    struct vm_area_struct *vma);
+bool kdbus_ring_sqe_get(struct kdbus_ring *ring, struct kdbus_ring_sqe *sqe);
+void kdbus_ring_cqe_post(struct kdbus_ring *ring, u64 user_data,
+			 s64 result, u64 offset);
+bool kdbus_ring_cq_pending(const struct kdbus_ring *ring);
+#endif
@@ -41,12 +41,19 @@ TABLE(CMD) = {
 	ENUM(KDBUS_CMD_EP_MAKE),
 	ENUM(KDBUS_CMD_HELLO),
 	ENUM(KDBUS_CMD_MSG_SEND),
+	ENUM(KDBUS_CMD_MSG_SEND_BATCH),
 	ENUM(KDBUS_CMD_MSG_RECV),
+	ENUM(KDBUS_CMD_MSG_RECV_BATCH),
+	ENUM(KDBUS_CMD_RING_SETUP),
+	ENUM(KDBUS_CMD_RING_ENTER),
+	ENUM(KDBUS_CMD_ARENA_SETUP),
 	ENUM(KDBUS_CMD_NAME_LIST),
+	ENUM(KDBUS_CMD_NAME_LIST_BATCH),
 	ENUM(KDBUS_CMD_NAME_RELEASE),
 	ENUM(KDBUS_CMD_CONN_INFO),
 	ENUM(KDBUS_CMD_MATCH_ADD),
 	ENUM(KDBUS_CMD_MATCH_REMOVE),
+	ENUM(KDBUS_CMD_MATCH_STATS),
 	ENUM(KDBUS_CMD_EP_POLICY_SET),
 };
 LOOKUP(CMD);
@@ -56,6 +63,7 @@ TABLE(MSG) = {
 	ENUM(KDBUS_ITEM_PAYLOAD_VEC),
 	ENUM(KDBUS_ITEM_PAYLOAD_OFF),
 	ENUM(KDBUS_ITEM_PAYLOAD_MEMFD),
+	ENUM(KDBUS_ITEM_PAYLOAD_ARENA),
 	ENUM(KDBUS_ITEM_FDS),
 	ENUM(KDBUS_ITEM_BLOOM),
 	ENUM(KDBUS_ITEM_DST_NAME),
@@ -98,6 +98,61 @@ struct conn *connect_to_bus(const char *path, uint64_t hello_flags)
 	return conn;
 }
 
+/* connect without any metadata, to keep messages and replies small */
+struct conn *connect_plain(const char *path, uint64_t hello_flags,
+			   size_t pool_size)
+{
+	struct kdbus_cmd_hello hello = {};
+	struct conn *conn;
+	int fd, ret;
+
+	fd = open(path, O_RDWR|O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "--- error %d (%m)\n", fd);
+		return NULL;
+	}
+
+	hello.size = sizeof(hello);
+	hello.conn_flags = hello_flags;
+	hello.pool_size = pool_size;
+
+	ret = ioctl(fd, KDBUS_CMD_HELLO, &hello);
+	if (ret < 0) {
+		fprintf(stderr, "--- error when saying hello: %d (%m)\n", ret);
+		goto exit_close;
+	}
+
+	conn = malloc(sizeof(*conn));
+	if (!conn) {
+		fprintf(stderr, "unable to malloc()!?\n");
+		goto exit_close;
+	}
+
+	conn->buf = mmap(NULL, pool_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (conn->buf == MAP_FAILED) {
+		fprintf(stderr, "--- error mmap (%m)\n");
+		free(conn);
+		goto exit_close;
+	}
+
+	conn->fd = fd;
+	conn->id = hello.id;
+	conn->size = pool_size;
+	return conn;
+
+exit_close:
+	close(fd);
+	return NULL;
+}
+
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 int msg_send(const struct conn *conn,
 	     const char *name,
 	     uint64_t cookie,
@@ -304,6 +359,13 @@ void msg_dump(const struct conn *conn, const struct kdbus_msg *msg)
 			break;
 		}
 
+		case KDBUS_ITEM_PAYLOAD_ARENA:
+			printf("  +%s (%llu bytes) off=%llu size=%llu\n",
+			       enum_MSG(item->type), item->size,
+			       (unsigned long long)item->vec.offset,
+			       (unsigned long long)item->vec.size);
+			break;
+
 		case KDBUS_ITEM_PAYLOAD_MEMFD: {
 			char *buf;
 			uint64_t size;
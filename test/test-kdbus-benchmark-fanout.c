@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "kdbus-util.h"
+#include "kdbus-enum.h"
+
+/*
+ * Measures the delivery of broadcasts to growing numbers of subscribers.
+ * Every round sends a burst of broadcasts, which are delivered to all
+ * receivers before the send call returns, and then drains the receivers'
+ * queues outside of the measurement.
+ *
+ * If the module parameter broadcast_batch is writable, every receiver count
+ * is run with serial delivery and with the configured value, to compare the
+ * parallel delivery against the serial one.
+ */
+
+#define POOL_SIZE (1024LU * 1024LU)
+#define MAX_RECEIVERS 1024
+#define BURST 16
+#define ROUNDS 50
+
+#define PARAM "/sys/module/" KBUILD_MODNAME "/parameters/broadcast_batch"
+
+static char payload[4096];
+
+static const unsigned int receivers[] = {
+	1, 16, 64, 256, 1024
+};
+
+static struct conn *conns[MAX_RECEIVERS];
+
+static int param_get(char *value, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	fd = open(PARAM, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	len = read(fd, value, size - 1);
+	close(fd);
+	if (len <= 0)
+		return -EIO;
+
+	value[len] = '\0';
+	return 0;
+}
+
+static int param_set(const char *value)
+{
+	int fd, ret = 0;
+
+	fd = open(PARAM, O_WRONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (write(fd, value, strlen(value)) < 0)
+		ret = -errno;
+
+	close(fd);
+	return ret;
+}
+
+static int drain(struct conn *conn)
+{
+	for (;;) {
+		struct kdbus_cmd_recv recv = {};
+		int ret;
+
+		ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+		if (ret < 0)
+			return errno == EAGAIN ? 0 : -errno;
+
+		ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+		if (ret < 0)
+			return -errno;
+	}
+}
+
+static int run(struct conn *src, unsigned int n, const char *mode)
+{
+	struct {
+		struct kdbus_msg msg;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			struct kdbus_vec vec;
+		} vec;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t data[8];
+		} bloom;
+	} m;
+	uint64_t send_ns = 0, t;
+	unsigned int r, i;
+	int ret;
+
+	memset(&m, 0, sizeof(m));
+	m.msg.size = sizeof(m);
+	m.msg.src_id = src->id;
+	m.msg.dst_id = KDBUS_DST_ID_BROADCAST;
+	m.msg.payload_type = KDBUS_PAYLOAD_DBUS;
+	m.vec.size = sizeof(m.vec);
+	m.vec.type = KDBUS_ITEM_PAYLOAD_VEC;
+	m.vec.vec.address = (uintptr_t) payload;
+	m.vec.vec.size = sizeof(payload);
+	m.bloom.size = sizeof(m.bloom);
+	m.bloom.type = KDBUS_ITEM_BLOOM;
+
+	for (r = 0; r < ROUNDS; r++) {
+		t = now_ns();
+		for (i = 0; i < BURST; i++) {
+			m.msg.cookie = i + 1;
+			ret = ioctl(src->fd, KDBUS_CMD_MSG_SEND, &m);
+			if (ret < 0) {
+				fprintf(stderr, "error sending message: %d (%m)\n", ret);
+				return EXIT_FAILURE;
+			}
+		}
+		send_ns += now_ns() - t;
+
+		for (i = 0; i < n; i++) {
+			ret = drain(conns[i]);
+			if (ret < 0) {
+				fprintf(stderr, "error receiving message: %d\n", ret);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	printf("%-8s %5u receivers: %9llu ns/broadcast, %6llu ns/receiver\n",
+	       mode, n,
+	       (unsigned long long) (send_ns / (ROUNDS * BURST)),
+	       (unsigned long long) (send_ns / (ROUNDS * BURST * n)));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct {
+		struct kdbus_cmd_make head;
+
+		/* bloom size item */
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom_size;
+		} bs;
+
+		/* name item */
+		uint64_t n_size;
+		uint64_t n_type;
+		char name[64];
+	} bus_make;
+	struct conn *src;
+	unsigned int i, n = 0;
+	char batch[32];
+	bool serial;
+	char *bus;
+	int fdc, ret;
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = i;
+
+	printf("-- opening /dev/" KBUILD_MODNAME "/control\n");
+	fdc = open("/dev/" KBUILD_MODNAME "/control", O_RDWR|O_CLOEXEC);
+	if (fdc < 0) {
+		fprintf(stderr, "--- error %d (%m)\n", fdc);
+		return EXIT_FAILURE;
+	}
+
+	memset(&bus_make, 0, sizeof(bus_make));
+	bus_make.bs.size = sizeof(bus_make.bs);
+	bus_make.bs.type = KDBUS_ITEM_BLOOM_SIZE;
+	bus_make.bs.bloom_size = 64;
+
+	snprintf(bus_make.name, sizeof(bus_make.name), "%u-fanoutbench", getuid());
+	bus_make.n_type = KDBUS_ITEM_MAKE_NAME;
+	bus_make.n_size = KDBUS_ITEM_HEADER_SIZE + strlen(bus_make.name) + 1;
+
+	bus_make.head.size = sizeof(struct kdbus_cmd_make) +
+			     sizeof(bus_make.bs) +
+			     bus_make.n_size;
+
+	printf("-- creating bus '%s'\n", bus_make.name);
+	ret = ioctl(fdc, KDBUS_CMD_BUS_MAKE, &bus_make);
+	if (ret) {
+		fprintf(stderr, "--- error %d (%m)\n", ret);
+		return EXIT_FAILURE;
+	}
+
+	if (asprintf(&bus, "/dev/" KBUILD_MODNAME "/%s/bus", bus_make.name) < 0)
+		return EXIT_FAILURE;
+
+	src = connect_plain(bus, 0, POOL_SIZE);
+	if (!src)
+		return EXIT_FAILURE;
+
+	/* compare against serial delivery, if we may change the parameter */
+	serial = param_get(batch, sizeof(batch)) == 0 && param_set(batch) == 0;
+	if (!serial)
+		printf("-- cannot write " PARAM ", measuring the current value only\n");
+
+	for (i = 0; i < ELEMENTSOF(receivers); i++) {
+		/* connect and subscribe the additional receivers */
+		for (; n < receivers[i]; n++) {
+			conns[n] = connect_plain(bus, 0, POOL_SIZE);
+			if (!conns[n]) {
+				fprintf(stderr, "--- stopping at %u receivers\n", n);
+				goto exit;
+			}
+
+			add_match_empty(conns[n]->fd);
+		}
+
+		if (serial) {
+			param_set("0");
+			ret = run(src, n, "serial");
+			param_set(batch);
+			if (ret)
+				return EXIT_FAILURE;
+		}
+
+		ret = run(src, n, "parallel");
+		if (ret)
+			return EXIT_FAILURE;
+	}
+
+exit:
+	for (i = 0; i < n; i++) {
+		close(conns[i]->fd);
+		free(conns[i]);
+	}
+
+	close(src->fd);
+	free(src);
+	close(fdc);
+	free(bus);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "kdbus-util.h"
+#include "kdbus-enum.h"
+
+/*
+ * Measures the lookup of well-known names while the name registry fills
+ * up. Every step adds connections owning NAMES_PER_CONN names each, until
+ * the next name count is reached, and then looks up registered and unknown
+ * names with KDBUS_CMD_CONN_INFO. The lookup latency should stay flat while
+ * the registry grows its hash table.
+ *
+ * The last steps need more connections than a user may open, so the full
+ * run needs CAP_IPC_OWNER, and a file descriptor limit above NAMES_MAX /
+ * NAMES_PER_CONN.
+ */
+
+#define POOL_SIZE (1024LU * 1024LU)
+#define OWNER_POOL_SIZE (64LU * 1024LU)
+#define NAMES_PER_CONN 64
+#define LOOKUPS 20000
+#define NAMES_MAX 131072
+
+static const unsigned int steps[] = {
+	64, 1024, 8192, 32768, 65536, NAMES_MAX
+};
+
+static int acquire(struct conn *conn, unsigned int n)
+{
+	struct {
+		struct kdbus_cmd_name head;
+		char name[64];
+	} cmd;
+	int ret;
+
+	memset(&cmd, 0, sizeof(cmd));
+	snprintf(cmd.name, sizeof(cmd.name), "foo.bench.name%u", n);
+	cmd.head.size = sizeof(cmd.head) + strlen(cmd.name) + 1;
+
+	ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, &cmd);
+	if (ret < 0) {
+		fprintf(stderr, "error acquiring name: %d (%m)\n", ret);
+		return EXIT_FAILURE;
+	}
+
+	return 0;
+}
+
+/* returns the average latency, or 0 on failure */
+static uint64_t lookup(struct conn *conn, unsigned int n_names, bool miss)
+{
+	struct {
+		struct kdbus_cmd_conn_info head;
+		char name[64];
+	} cmd;
+	uint64_t ns = 0, t;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < LOOKUPS; i++) {
+		unsigned int n = (i * 7919) % n_names;
+
+		memset(&cmd, 0, sizeof(cmd));
+		snprintf(cmd.name, sizeof(cmd.name), "foo.bench.%s%u",
+			 miss ? "miss" : "name", n);
+		cmd.head.size = sizeof(cmd.head) + strlen(cmd.name) + 1;
+
+		t = now_ns();
+		ret = ioctl(conn->fd, KDBUS_CMD_CONN_INFO, &cmd);
+		ns += now_ns() - t;
+
+		if (miss) {
+			if (ret == 0 || errno != ENOENT) {
+				fprintf(stderr, "unexpected lookup result: %d (%m)\n", ret);
+				return 0;
+			}
+			continue;
+		}
+
+		if (ret < 0) {
+			fprintf(stderr, "error looking up name: %d (%m)\n", ret);
+			return 0;
+		}
+
+		ret = ioctl(conn->fd, KDBUS_CMD_FREE, &cmd.head.offset);
+		if (ret < 0) {
+			fprintf(stderr, "error free info: %d (%m)\n", ret);
+			return 0;
+		}
+	}
+
+	return ns / LOOKUPS ? : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct {
+		struct kdbus_cmd_make head;
+
+		/* bloom size item */
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom_size;
+		} bs;
+
+		/* name item */
+		uint64_t n_size;
+		uint64_t n_type;
+		char name[64];
+	} bus_make;
+	static struct conn *conns[NAMES_MAX / NAMES_PER_CONN];
+	struct conn *conn;
+	unsigned int n_conns = 0, n_names = 0;
+	unsigned int i;
+	struct rlimit rl;
+	char *bus;
+	int fdc, ret;
+
+	/* one descriptor per name owner, plus a few for ourselves */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+	    rl.rlim_cur < NAMES_MAX / NAMES_PER_CONN + 16) {
+		rl.rlim_cur = NAMES_MAX / NAMES_PER_CONN + 16;
+		if (rl.rlim_max < rl.rlim_cur)
+			rl.rlim_max = rl.rlim_cur;
+		if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+			fprintf(stderr, "unable to raise the file limit (%m)\n");
+	}
+
+	printf("-- opening /dev/" KBUILD_MODNAME "/control\n");
+	fdc = open("/dev/" KBUILD_MODNAME "/control", O_RDWR|O_CLOEXEC);
+	if (fdc < 0) {
+		fprintf(stderr, "--- error %d (%m)\n", fdc);
+		return EXIT_FAILURE;
+	}
+
+	memset(&bus_make, 0, sizeof(bus_make));
+	bus_make.bs.size = sizeof(bus_make.bs);
+	bus_make.bs.type = KDBUS_ITEM_BLOOM_SIZE;
+	bus_make.bs.bloom_size = 64;
+
+	snprintf(bus_make.name, sizeof(bus_make.name), "%u-namesbench", getuid());
+	bus_make.n_type = KDBUS_ITEM_MAKE_NAME;
+	bus_make.n_size = KDBUS_ITEM_HEADER_SIZE + strlen(bus_make.name) + 1;
+
+	bus_make.head.size = sizeof(struct kdbus_cmd_make) +
+			     sizeof(bus_make.bs) +
+			     bus_make.n_size;
+
+	printf("-- creating bus '%s'\n", bus_make.name);
+	ret = ioctl(fdc, KDBUS_CMD_BUS_MAKE, &bus_make);
+	if (ret) {
+		fprintf(stderr, "--- error %d (%m)\n", ret);
+		return EXIT_FAILURE;
+	}
+
+	if (asprintf(&bus, "/dev/" KBUILD_MODNAME "/%s/bus", bus_make.name) < 0)
+		return EXIT_FAILURE;
+
+	conn = connect_plain(bus, 0, POOL_SIZE);
+	if (!conn)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < ELEMENTSOF(steps); i++) {
+		uint64_t acquire_ns = 0, hit_ns, miss_ns, t;
+		unsigned int added = steps[i] - n_names;
+
+		while (n_names < steps[i]) {
+			if (n_names % NAMES_PER_CONN == 0) {
+				conns[n_conns] = connect_plain(bus, 0,
+							       OWNER_POOL_SIZE);
+				if (!conns[n_conns])
+					return EXIT_FAILURE;
+				n_conns++;
+			}
+
+			t = now_ns();
+			ret = acquire(conns[n_conns - 1], n_names);
+			acquire_ns += now_ns() - t;
+			if (ret)
+				return EXIT_FAILURE;
+			n_names++;
+		}
+		acquire_ns /= added;
+
+		hit_ns = lookup(conn, n_names, false);
+		miss_ns = lookup(conn, n_names, true);
+		if (!hit_ns || !miss_ns)
+			return EXIT_FAILURE;
+
+		printf("%6u names: acquire %6llu ns/name, lookup %6llu ns, "
+		       "lookup unknown %6llu ns\n",
+		       n_names,
+		       (unsigned long long) acquire_ns,
+		       (unsigned long long) hit_ns,
+		       (unsigned long long) miss_ns);
+	}
+
+	for (i = 0; i < n_conns; i++) {
+		close(conns[i]->fd);
+		free(conns[i]);
+	}
+	close(conn->fd);
+	free(conn);
+	close(fdc);
+	free(bus);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "kdbus-util.h"
+#include "kdbus-enum.h"
+
+/*
+ * Measures the receiver's pool: every round queues a burst of messages of
+ * one size, which allocates from the pool and copies the payload to it, and
+ * then receives and frees all of them. KDBUS_CMD_FREE does little more than
+ * a lookup under the pool lock, so its cost approximates the lock hold time.
+ *
+ * All sizes are run against a regular pool and against a pool created with
+ * KDBUS_HELLO_POOL_MAPPED, to compare the two write paths.
+ */
+
+#define POOL_SIZE (16 * 1024LU * 1024LU)
+#define BURST 32
+#define ROUNDS 2000
+
+/* the total amount of payload data of one run */
+#define DATA_MAX (2048 * 1024LU * 1024LU)
+
+static char payload[2 * 1024 * 1024];
+
+static const size_t sizes[] = {
+	0, 64, 256, 768, 4096, 65536, 256 * 1024, 2 * 1024 * 1024
+};
+
+static int run_size(struct conn *src, struct conn *dst, size_t size)
+{
+	struct {
+		struct kdbus_msg msg;
+		uint64_t size;
+		uint64_t type;
+		struct kdbus_vec vec;
+	} m;
+	uint64_t offsets[BURST];
+	uint64_t send_ns = 0, free_ns = 0, t;
+	unsigned int burst = BURST, rounds = ROUNDS;
+	unsigned int r, i;
+	int ret;
+
+	/* a burst may take at most a quarter of the pool */
+	if (size * burst > POOL_SIZE / 4)
+		burst = (POOL_SIZE / 4) / size;
+
+	if ((uint64_t) size * burst * rounds > DATA_MAX)
+		rounds = DATA_MAX / ((uint64_t) size * burst);
+
+	memset(&m, 0, sizeof(m));
+	m.msg.size = size ? sizeof(m) : sizeof(m.msg);
+	m.msg.src_id = src->id;
+	m.msg.dst_id = dst->id;
+	m.msg.payload_type = KDBUS_PAYLOAD_DBUS;
+	m.size = KDBUS_ITEM_HEADER_SIZE + sizeof(struct kdbus_vec);
+	m.type = KDBUS_ITEM_PAYLOAD_VEC;
+	m.vec.address = (uintptr_t) payload;
+	m.vec.size = size;
+
+	for (r = 0; r < rounds; r++) {
+		t = now_ns();
+		for (i = 0; i < burst; i++) {
+			m.msg.cookie = i + 1;
+			ret = ioctl(src->fd, KDBUS_CMD_MSG_SEND, &m);
+			if (ret < 0) {
+				fprintf(stderr, "error sending message: %d (%m)\n", ret);
+				return EXIT_FAILURE;
+			}
+		}
+		send_ns += now_ns() - t;
+
+		for (i = 0; i < burst; i++) {
+			struct kdbus_cmd_recv recv = {};
+
+			ret = ioctl(dst->fd, KDBUS_CMD_MSG_RECV, &recv);
+			if (ret < 0) {
+				fprintf(stderr, "error receiving message: %d (%m)\n", ret);
+				return EXIT_FAILURE;
+			}
+
+			offsets[i] = recv.offset;
+		}
+
+		t = now_ns();
+		for (i = 0; i < burst; i++) {
+			ret = ioctl(dst->fd, KDBUS_CMD_FREE, &offsets[i]);
+			if (ret < 0) {
+				fprintf(stderr, "error free message: %d (%m)\n", ret);
+				return EXIT_FAILURE;
+			}
+		}
+		free_ns += now_ns() - t;
+	}
+
+	printf("payload %7zu bytes: send %8llu ns/msg, free %6llu ns/msg\n",
+	       size,
+	       (unsigned long long) (send_ns / (rounds * burst)),
+	       (unsigned long long) (free_ns / (rounds * burst)));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct {
+		struct kdbus_cmd_make head;
+
+		/* bloom size item */
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom_size;
+		} bs;
+
+		/* name item */
+		uint64_t n_size;
+		uint64_t n_type;
+		char name[64];
+	} bus_make;
+	struct conn *conn_a, *conn_b, *conn_c;
+	unsigned int i;
+	char *bus;
+	int fdc, ret;
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = i;
+
+	printf("-- opening /dev/" KBUILD_MODNAME "/control\n");
+	fdc = open("/dev/" KBUILD_MODNAME "/control", O_RDWR|O_CLOEXEC);
+	if (fdc < 0) {
+		fprintf(stderr, "--- error %d (%m)\n", fdc);
+		return EXIT_FAILURE;
+	}
+
+	memset(&bus_make, 0, sizeof(bus_make));
+	bus_make.bs.size = sizeof(bus_make.bs);
+	bus_make.bs.type = KDBUS_ITEM_BLOOM_SIZE;
+	bus_make.bs.bloom_size = 64;
+
+	snprintf(bus_make.name, sizeof(bus_make.name), "%u-poolbench", getuid());
+	bus_make.n_type = KDBUS_ITEM_MAKE_NAME;
+	bus_make.n_size = KDBUS_ITEM_HEADER_SIZE + strlen(bus_make.name) + 1;
+
+	bus_make.head.size = sizeof(struct kdbus_cmd_make) +
+			     sizeof(bus_make.bs) +
+			     bus_make.n_size;
+
+	printf("-- creating bus '%s'\n", bus_make.name);
+	ret = ioctl(fdc, KDBUS_CMD_BUS_MAKE, &bus_make);
+	if (ret) {
+		fprintf(stderr, "--- error %d (%m)\n", ret);
+		return EXIT_FAILURE;
+	}
+
+	if (asprintf(&bus, "/dev/" KBUILD_MODNAME "/%s/bus", bus_make.name) < 0)
+		return EXIT_FAILURE;
+
+	conn_a = connect_plain(bus, 0, POOL_SIZE);
+	conn_b = connect_plain(bus, 0, POOL_SIZE);
+	conn_c = connect_plain(bus, KDBUS_HELLO_POOL_MAPPED, POOL_SIZE);
+	if (!conn_a || !conn_b || !conn_c)
+		return EXIT_FAILURE;
+
+	printf("-- regular pool\n");
+	for (i = 0; i < ELEMENTSOF(sizes); i++) {
+		ret = run_size(conn_a, conn_b, sizes[i]);
+		if (ret)
+			return EXIT_FAILURE;
+	}
+
+	printf("-- mapped pool\n");
+	for (i = 0; i < ELEMENTSOF(sizes); i++) {
+		ret = run_size(conn_a, conn_c, sizes[i]);
+		if (ret)
+			return EXIT_FAILURE;
+	}
+
+	close(conn_a->fd);
+	close(conn_b->fd);
+	close(conn_c->fd);
+	free(conn_a);
+	free(conn_b);
+	free(conn_c);
+	close(fdc);
+	free(bus);
+
+	return EXIT_SUCCESS;
+}
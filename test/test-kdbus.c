@@ -27,6 +27,7 @@ enum {
 enum {
 	CHECK_CREATE_BUS	= 1 << 0,
 	CHECK_CREATE_CONN	= 1 << 1,
+	CHECK_CREATE_ARENA	= 1 << 2,
 };
 
 struct kdbus_conn {
@@ -665,6 +666,72 @@ static int check_name_queue(struct kdbus_check_env *env)
 	return CHECK_OK;
 }
 
+static int check_name_queue_replace(struct kdbus_check_env *env)
+{
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conn;
+	uint64_t size;
+	char *name;
+	int ret;
+
+	name = "foo.bla.blaz";
+	ret = upload_policy(env->conn->fd, name);
+	ASSERT_RETURN(ret == 0);
+
+	size = sizeof(*cmd_name) + strlen(name) + 1;
+	cmd_name = alloca(size);
+
+	memset(cmd_name, 0, size);
+	strcpy(cmd_name->name, name);
+	cmd_name->size = size;
+	cmd_name->flags = KDBUS_NAME_ALLOW_REPLACEMENT;
+
+	/* create a 2nd connection */
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	/* allow the new connection to own the same name */
+	ret = upload_policy(conn->fd, name);
+	ASSERT_RETURN(ret == 0);
+
+	/* acquire name from the 1st connection */
+	ret = ioctl(env->conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+
+	/* queue the 2nd connection as waiting owner */
+	cmd_name->flags = KDBUS_NAME_QUEUE;
+	ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(cmd_name->flags & KDBUS_NAME_IN_QUEUE);
+
+	/* the queued 2nd connection takes the name over */
+	cmd_name->flags = KDBUS_NAME_REPLACE_EXISTING;
+	ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+
+	ret = conn_is_name_owner(conn, KDBUS_NAME_LIST_NAMES, name);
+	ASSERT_RETURN(ret == 0);
+
+	/* ... and does not wait for it any longer */
+	ret = conn_is_name_owner(conn, KDBUS_NAME_LIST_QUEUED, name);
+	ASSERT_RETURN(ret != 0);
+
+	/* release name from the 2nd connection, nobody else waits for it */
+	cmd_name->flags = 0;
+	ret = ioctl(conn->fd, KDBUS_CMD_NAME_RELEASE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+
+	ret = conn_is_name_owner(conn, KDBUS_NAME_LIST_NAMES, name);
+	ASSERT_RETURN(ret != 0);
+
+	ret = conn_is_name_owner(env->conn, KDBUS_NAME_LIST_NAMES, name);
+	ASSERT_RETURN(ret != 0);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
 static int check_conn_info(struct kdbus_check_env *env)
 {
 	int ret;
@@ -784,6 +851,76 @@ static int check_match_id_remove(struct kdbus_check_env *env)
 	return CHECK_OK;
 }
 
+/* receive one ID notification and return its ID, or 0 if the queue is empty */
+static uint64_t recv_id_change(const struct kdbus_conn *conn)
+{
+	struct kdbus_cmd_recv recv = {};
+	struct kdbus_msg *msg;
+	uint64_t id;
+
+	if (ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv) < 0)
+		return 0;
+
+	msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+	id = msg->items[0].id_change.id;
+	ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+
+	return id;
+}
+
+static int check_match_id_remove_index(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			struct kdbus_notify_id_change chg;
+		} item;
+	} buf;
+	struct kdbus_conn *watch_x, *watch_any, *conn_x, *conn_y;
+	uint64_t id_x, id_y;
+	int ret;
+
+	watch_x = make_conn(env->buspath, 0);
+	watch_any = make_conn(env->buspath, 0);
+	conn_x = make_conn(env->buspath, 0);
+	conn_y = make_conn(env->buspath, 0);
+	ASSERT_RETURN(watch_x && watch_any && conn_x && conn_y);
+
+	id_x = conn_x->hello.id;
+	id_y = conn_y->hello.id;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_ID_REMOVE;
+
+	/* one watcher for a specific connection, one for all of them */
+	buf.item.chg.id = id_x;
+	ret = ioctl(watch_x->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	buf.item.chg.id = KDBUS_MATCH_ID_ANY;
+	ret = ioctl(watch_any->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	free_conn(conn_y);
+
+	ASSERT_RETURN(recv_id_change(watch_any) == id_y);
+	ASSERT_RETURN(recv_id_change(watch_x) == 0);
+
+	free_conn(conn_x);
+
+	ASSERT_RETURN(recv_id_change(watch_any) == id_x);
+	ASSERT_RETURN(recv_id_change(watch_x) == id_x);
+
+	free_conn(watch_x);
+	free_conn(watch_any);
+
+	return CHECK_OK;
+}
+
 static int check_match_name_add(struct kdbus_check_env *env)
 {
 	struct {
@@ -908,6 +1045,167 @@ static int check_match_name_remove(struct kdbus_check_env *env)
 	return CHECK_OK;
 }
 
+static int check_match_notify_batch(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			struct kdbus_notify_name_change chg;
+		} item;
+	} buf;
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conn;
+	unsigned int i, names = 0;
+	char name[64];
+	uint64_t id;
+	int ret;
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+	id = conn->hello.id;
+
+	/* the connection owns three names */
+	cmd_name = alloca(sizeof(*cmd_name) + sizeof(name));
+
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "foo.bla.batch%u", i);
+		ret = upload_policy(conn->fd, name);
+		ASSERT_RETURN(ret == 0);
+
+		memset(cmd_name, 0, sizeof(*cmd_name) + sizeof(name));
+		strcpy(cmd_name->name, name);
+		cmd_name->size = sizeof(*cmd_name) + strlen(name) + 1;
+		ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	/* watch the removal of all names of the connection */
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_NAME_REMOVE;
+	buf.item.chg.old.id = id;
+	buf.item.chg.new.id = KDBUS_MATCH_ID_ANY;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	/* the names are released in one batch of notifications */
+	free_conn(conn);
+
+	for (;;) {
+		struct kdbus_cmd_recv recv = {};
+		struct kdbus_item *item;
+		struct kdbus_msg *msg;
+
+		ret = ioctl(env->conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+		if (ret < 0)
+			break;
+
+		msg = (struct kdbus_msg *)(env->conn->buf + recv.offset);
+		item = &msg->items[0];
+		ASSERT_RETURN(item->type == KDBUS_ITEM_NAME_REMOVE);
+		ASSERT_RETURN(item->name_change.old.id == id);
+		ASSERT_RETURN(strncmp(item->name_change.name,
+				      "foo.bla.batch", 13) == 0);
+		names++;
+
+		ret = ioctl(env->conn->fd, KDBUS_CMD_FREE, &recv.offset);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	ASSERT_RETURN(errno == EAGAIN);
+	ASSERT_RETURN(names == 3);
+
+	return CHECK_OK;
+}
+
+static int check_match_name_atom(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			struct kdbus_notify_name_change chg;
+			char name[64];
+		} item;
+	} buf;
+	static const char * const names[] = {
+		"foo.bla.atom", "foo.bla.atomx", "foo.bla.atom",
+	};
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conn;
+	unsigned int i, adds = 0;
+	uint64_t size;
+	int ret;
+
+	/* subscribe to a name before anybody uses it */
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_NAME_ADD;
+	buf.item.chg.old.id = KDBUS_MATCH_ID_ANY;
+	buf.item.chg.new.id = KDBUS_MATCH_ID_ANY;
+	strncpy(buf.item.name, names[0], sizeof(buf.item.name));
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	ret = upload_policy(conn->fd, names[0]);
+	ASSERT_RETURN(ret == 0);
+	ret = upload_policy(conn->fd, names[1]);
+	ASSERT_RETURN(ret == 0);
+
+	/* acquire and release the names, the watched one twice */
+	size = sizeof(*cmd_name) + sizeof(buf.item.name);
+	cmd_name = alloca(size);
+
+	for (i = 0; i < ELEMENTSOF(names); i++) {
+		memset(cmd_name, 0, size);
+		strcpy(cmd_name->name, names[i]);
+		cmd_name->size = sizeof(*cmd_name) + strlen(names[i]) + 1;
+
+		ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+		ASSERT_RETURN(ret == 0);
+
+		cmd_name->flags = 0;
+		ret = ioctl(conn->fd, KDBUS_CMD_NAME_RELEASE, cmd_name);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	/* only the additions of the watched name are delivered */
+	for (;;) {
+		struct kdbus_cmd_recv recv = {};
+		struct kdbus_item *item;
+		struct kdbus_msg *msg;
+
+		ret = ioctl(env->conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+		if (ret < 0)
+			break;
+
+		msg = (struct kdbus_msg *)(env->conn->buf + recv.offset);
+		item = &msg->items[0];
+		ASSERT_RETURN(item->type == KDBUS_ITEM_NAME_ADD);
+		ASSERT_RETURN(item->name_change.new.id == conn->hello.id);
+		ASSERT_RETURN(strcmp(item->name_change.name, names[0]) == 0);
+		adds++;
+
+		ret = ioctl(env->conn->fd, KDBUS_CMD_FREE, &recv.offset);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	ASSERT_RETURN(errno == EAGAIN);
+	ASSERT_RETURN(adds == 2);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
 static int check_match_name_change(struct kdbus_check_env *env)
 {
 	struct {
@@ -990,55 +1288,1029 @@ static int check_match_name_change(struct kdbus_check_env *env)
 	return CHECK_OK;
 }
 
-static int check_msg_basic(struct kdbus_check_env *env)
+static int send_bloom(const struct kdbus_conn *conn, uint64_t cookie,
+		      const uint64_t bloom[8])
+{
+	struct {
+		struct kdbus_msg msg;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom[8];
+		} item;
+	} m;
+
+	memset(&m, 0, sizeof(m));
+	m.msg.size = sizeof(m);
+	m.msg.src_id = conn->hello.id;
+	m.msg.dst_id = KDBUS_DST_ID_BROADCAST;
+	m.msg.cookie = cookie;
+	m.msg.payload_type = KDBUS_PAYLOAD_DBUS;
+	m.item.size = sizeof(m.item);
+	m.item.type = KDBUS_ITEM_BLOOM;
+	memcpy(m.item.bloom, bloom, sizeof(m.item.bloom));
+
+	return ioctl(conn->fd, KDBUS_CMD_MSG_SEND, &m);
+}
+
+/* receive one message and return its cookie, or 0 if the queue is empty */
+static uint64_t recv_cookie(const struct kdbus_conn *conn)
 {
-	struct kdbus_conn *conn;
-	struct kdbus_msg *msg;
-	uint64_t cookie = 0x1234abcd5678eeff;
-	struct pollfd fd;
 	struct kdbus_cmd_recv recv = {};
+	struct kdbus_msg *msg;
+	uint64_t cookie;
+
+	if (ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv) < 0)
+		return 0;
+
+	msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+	cookie = msg->cookie;
+	ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+
+	return cookie;
+}
+
+static int check_name_send(struct kdbus_check_env *env)
+{
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conn;
+	uint64_t size;
+	unsigned int i;
+	char *name;
 	int ret;
 
-	/* create a 2nd connection */
+	name = "foo.bla.send";
+
 	conn = make_conn(env->buspath, 0);
 	ASSERT_RETURN(conn != NULL);
 
-	add_match_empty(conn->fd);
-	add_match_empty(env->conn->fd);
-
-	/* send over 1st connection */
-	ret = send_message(env->conn, NULL, cookie, KDBUS_DST_ID_BROADCAST);
+	ret = upload_policy(conn->fd, name);
 	ASSERT_RETURN(ret == 0);
 
-	/* ... and receive on the 2nd */
-	fd.fd = conn->fd;
-	fd.events = POLLIN | POLLPRI | POLLHUP;
-	fd.revents = 0;
+	size = sizeof(*cmd_name) + strlen(name) + 1;
+	cmd_name = alloca(size);
 
-	ret = poll(&fd, 1, 100);
-	ASSERT_RETURN(ret > 0 && (fd.revents & POLLIN));
+	memset(cmd_name, 0, size);
+	strcpy(cmd_name->name, name);
+	cmd_name->size = size;
 
-	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
-	ASSERT_RETURN(ret == 0);
+	/* the name is looked up for every message, while it comes and goes */
+	for (i = 0; i < 3; i++) {
+		cmd_name->flags = 0;
+		ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+		ASSERT_RETURN(ret == 0);
 
-	msg = (struct kdbus_msg *)(conn->buf + recv.offset);
-	ASSERT_RETURN(msg->cookie == cookie);
+		ret = send_message(env->conn, name, 0xf100 + i, 0);
+		ASSERT_RETURN(ret == 0);
+		ASSERT_RETURN(recv_cookie(conn) == 0xf100 + i);
 
-	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
-	ASSERT_RETURN(ret == 0);
+		ret = ioctl(conn->fd, KDBUS_CMD_NAME_RELEASE, cmd_name);
+		ASSERT_RETURN(ret == 0);
+
+		ret = send_message(env->conn, name, 0xf200 + i, 0);
+		ASSERT_RETURN(ret != 0);
+	}
 
 	free_conn(conn);
 
 	return CHECK_OK;
 }
 
-static int check_msg_free(struct kdbus_check_env *env)
+static int check_name_list_batch(struct kdbus_check_env *env)
 {
+	struct kdbus_cmd_name_list_batch cmd;
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conns[4];
+	unsigned int i, batches = 0, ids = 0, names = 0;
+	uint64_t last_id = 0;
+	char name[64];
 	int ret;
-	uint64_t off = 0;
 
-	/* free an unallocated buffer */
-	ret = ioctl(env->conn->fd, KDBUS_CMD_FREE, &off);
+	cmd_name = alloca(sizeof(*cmd_name) + sizeof(name));
+
+	for (i = 0; i < ELEMENTSOF(conns); i++) {
+		conns[i] = make_conn(env->buspath, 0);
+		ASSERT_RETURN(conns[i] != NULL);
+
+		snprintf(name, sizeof(name), "foo.bla.list%u", i);
+		ret = upload_policy(conns[i]->fd, name);
+		ASSERT_RETURN(ret == 0);
+
+		memset(cmd_name, 0, sizeof(*cmd_name) + sizeof(name));
+		strcpy(cmd_name->name, name);
+		cmd_name->size = sizeof(*cmd_name) + strlen(name) + 1;
+		ret = ioctl(conns[i]->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	/* a batch must at least hold the list header */
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.size = sizeof(cmd);
+	cmd.flags = KDBUS_NAME_LIST_UNIQUE | KDBUS_NAME_LIST_NAMES;
+	cmd.max_size = sizeof(struct kdbus_name_list) - 1;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_NAME_LIST_BATCH, &cmd);
+	ASSERT_RETURN(ret < 0 && errno == EINVAL);
+
+	/* the records of one connection do not fit */
+	cmd.max_size = sizeof(struct kdbus_name_list) +
+		       sizeof(struct kdbus_cmd_name);
+	cmd.cursor = conns[0]->hello.id;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_NAME_LIST_BATCH, &cmd);
+	ASSERT_RETURN(ret < 0 && errno == ENOBUFS);
+
+	/* room for the records of exactly one connection per batch */
+	cmd.max_size = sizeof(struct kdbus_name_list) +
+		       sizeof(struct kdbus_cmd_name) +
+		       KDBUS_ALIGN8(strlen("foo.bla.list0") + 1);
+	cmd.cursor = 0;
+
+	do {
+		struct kdbus_name_list *list;
+
+		ret = ioctl(env->conn->fd, KDBUS_CMD_NAME_LIST_BATCH, &cmd);
+		ASSERT_RETURN(ret == 0);
+		ASSERT_RETURN(cmd.cursor == 0 || cmd.cursor > last_id);
+		batches++;
+
+		list = (struct kdbus_name_list *)(env->conn->buf + cmd.offset);
+		ASSERT_RETURN(list->size <= cmd.max_size);
+
+		KDBUS_ITEM_FOREACH(cmd_name, list, names) {
+			ASSERT_RETURN(cmd_name->owner_id > last_id);
+			last_id = cmd_name->owner_id;
+
+			if (cmd_name->size > sizeof(*cmd_name)) {
+				ASSERT_RETURN(strncmp(cmd_name->name,
+						      "foo.bla.list", 12) == 0);
+				names++;
+			} else {
+				ASSERT_RETURN(cmd_name->owner_id ==
+					      env->conn->hello.id);
+				ids++;
+			}
+		}
+
+		ret = ioctl(env->conn->fd, KDBUS_CMD_FREE, &cmd.offset);
+		ASSERT_RETURN(ret == 0);
+	} while (cmd.cursor != 0);
+
+	ASSERT_RETURN(ids == 1);
+	ASSERT_RETURN(names == ELEMENTSOF(conns));
+	ASSERT_RETURN(batches == 1 + ELEMENTSOF(conns));
+
+	for (i = 0; i < ELEMENTSOF(conns); i++)
+		free_conn(conns[i]);
+
+	return CHECK_OK;
+}
+
+static int check_conn_id_lookup(struct kdbus_check_env *env)
+{
+	struct kdbus_conn *conns[32];
+	uint64_t ids[32];
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < ELEMENTSOF(conns); i++) {
+		conns[i] = make_conn(env->buspath, 0);
+		ASSERT_RETURN(conns[i] != NULL);
+		ids[i] = conns[i]->hello.id;
+	}
+
+	/* every second connection goes away again */
+	for (i = 0; i < ELEMENTSOF(conns); i += 2)
+		free_conn(conns[i]);
+
+	for (i = 0; i < ELEMENTSOF(conns); i++) {
+		ret = send_message(env->conn, NULL, 0xa100 + i, ids[i]);
+		if (i % 2 == 0) {
+			ASSERT_RETURN(ret != 0);
+			continue;
+		}
+
+		ASSERT_RETURN(ret == 0);
+		ASSERT_RETURN(recv_cookie(conns[i]) == 0xa100 + i);
+	}
+
+	for (i = 1; i < ELEMENTSOF(conns); i += 2)
+		free_conn(conns[i]);
+
+	return CHECK_OK;
+}
+
+static int check_match_bloom(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom[8];
+		} item;
+	} buf;
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t id;
+		} item;
+	} buf_id;
+	struct kdbus_conn *conn_bloom, *conn_id, *conn_other;
+	uint64_t bloom[8] = {};
+	int ret;
+
+	conn_bloom = make_conn(env->buspath, 0);
+	conn_id = make_conn(env->buspath, 0);
+	conn_other = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn_bloom && conn_id && conn_other);
+
+	/* match on bits 3 and 70 of the bloom filter */
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.cmd.cookie = 0xb100;
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_BLOOM;
+	buf.item.bloom[0] = 1ULL << 3;
+	buf.item.bloom[1] = 1ULL << 6;
+	ret = ioctl(conn_bloom->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	/* match on messages from the 1st connection */
+	memset(&buf_id, 0, sizeof(buf_id));
+	buf_id.cmd.size = sizeof(buf_id);
+	buf_id.cmd.cookie = 0x1d00;
+	buf_id.item.size = sizeof(buf_id.item);
+	buf_id.item.type = KDBUS_ITEM_ID;
+	buf_id.item.id = env->conn->hello.id;
+	ret = ioctl(conn_id->fd, KDBUS_CMD_MATCH_ADD, &buf_id);
+	ASSERT_RETURN(ret == 0);
+
+	/* match on messages from a connection which never sends */
+	buf_id.item.id = conn_bloom->hello.id;
+	ret = ioctl(conn_other->fd, KDBUS_CMD_MATCH_ADD, &buf_id);
+	ASSERT_RETURN(ret == 0);
+
+	/* only one of the two bits set */
+	bloom[0] = 1ULL << 3;
+	ret = send_bloom(env->conn, 0xc001, bloom);
+	ASSERT_RETURN(ret == 0);
+
+	ASSERT_RETURN(recv_cookie(conn_bloom) == 0);
+	ASSERT_RETURN(recv_cookie(conn_id) == 0xc001);
+	ASSERT_RETURN(recv_cookie(conn_other) == 0);
+
+	/* both bits set */
+	bloom[1] = 1ULL << 6;
+	ret = send_bloom(env->conn, 0xc002, bloom);
+	ASSERT_RETURN(ret == 0);
+
+	ASSERT_RETURN(recv_cookie(conn_bloom) == 0xc002);
+	ASSERT_RETURN(recv_cookie(conn_id) == 0xc002);
+	ASSERT_RETURN(recv_cookie(conn_other) == 0);
+
+	/* a removed match must no longer deliver */
+	buf.cmd.size = sizeof(buf.cmd);
+	ret = ioctl(conn_bloom->fd, KDBUS_CMD_MATCH_REMOVE, &buf.cmd);
+	ASSERT_RETURN(ret == 0);
+
+	ret = send_bloom(env->conn, 0xc003, bloom);
+	ASSERT_RETURN(ret == 0);
+
+	ASSERT_RETURN(recv_cookie(conn_bloom) == 0);
+	ASSERT_RETURN(recv_cookie(conn_id) == 0xc003);
+
+	free_conn(conn_bloom);
+	free_conn(conn_id);
+	free_conn(conn_other);
+
+	return CHECK_OK;
+}
+
+static int check_match_rules(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom[8];
+		} item[2];
+	} buf_bloom;
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t id;
+		} item[2];
+	} buf_id;
+	struct kdbus_conn *conn_rules, *conn_ids;
+	uint64_t bloom[8] = {};
+	unsigned int i;
+	int ret;
+
+	conn_rules = make_conn(env->buspath, 0);
+	conn_ids = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn_rules && conn_ids);
+
+	/* two ID rules which contradict each other never match */
+	memset(&buf_id, 0, sizeof(buf_id));
+	buf_id.cmd.size = sizeof(buf_id);
+	buf_id.cmd.cookie = 0x1d01;
+	buf_id.item[0].size = sizeof(buf_id.item[0]);
+	buf_id.item[0].type = KDBUS_ITEM_ID;
+	buf_id.item[0].id = env->conn->hello.id;
+	buf_id.item[1].size = sizeof(buf_id.item[1]);
+	buf_id.item[1].type = KDBUS_ITEM_ID;
+	buf_id.item[1].id = conn_ids->hello.id;
+	ret = ioctl(conn_rules->fd, KDBUS_CMD_MATCH_ADD, &buf_id);
+	ASSERT_RETURN(ret == 0);
+
+	/* two bloom rules in one entry must both be satisfied */
+	memset(&buf_bloom, 0, sizeof(buf_bloom));
+	buf_bloom.cmd.size = sizeof(buf_bloom);
+	buf_bloom.cmd.cookie = 0xb101;
+	buf_bloom.item[0].size = sizeof(buf_bloom.item[0]);
+	buf_bloom.item[0].type = KDBUS_ITEM_BLOOM;
+	buf_bloom.item[0].bloom[0] = 1ULL << 3;
+	buf_bloom.item[1].size = sizeof(buf_bloom.item[1]);
+	buf_bloom.item[1].type = KDBUS_ITEM_BLOOM;
+	buf_bloom.item[1].bloom[1] = 1ULL << 6;
+	ret = ioctl(conn_rules->fd, KDBUS_CMD_MATCH_ADD, &buf_bloom);
+	ASSERT_RETURN(ret == 0);
+
+	/* many entries for different senders, the sender's one in between */
+	memset(&buf_id, 0, sizeof(buf_id));
+	buf_id.cmd.size = sizeof(buf_id.cmd) + sizeof(buf_id.item[0]);
+	buf_id.item[0].size = sizeof(buf_id.item[0]);
+	buf_id.item[0].type = KDBUS_ITEM_ID;
+
+	for (i = 0; i < 32; i++) {
+		buf_id.cmd.cookie = 0x1d10 + i;
+		buf_id.item[0].id = env->conn->hello.id + 16 - i;
+
+		/* skip the sender, and IDs wrapped below 1 */
+		if (buf_id.item[0].id == env->conn->hello.id ||
+		    buf_id.item[0].id > env->conn->hello.id + 16)
+			continue;
+
+		ret = ioctl(conn_ids->fd, KDBUS_CMD_MATCH_ADD, &buf_id);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	bloom[0] = 1ULL << 3;
+	ret = send_bloom(env->conn, 0xc101, bloom);
+	ASSERT_RETURN(ret == 0);
+
+	ASSERT_RETURN(recv_cookie(conn_rules) == 0);
+	ASSERT_RETURN(recv_cookie(conn_ids) == 0);
+
+	buf_id.cmd.cookie = 0x1d00;
+	buf_id.item[0].id = env->conn->hello.id;
+	ret = ioctl(conn_ids->fd, KDBUS_CMD_MATCH_ADD, &buf_id);
+	ASSERT_RETURN(ret == 0);
+
+	bloom[1] = 1ULL << 6;
+	ret = send_bloom(env->conn, 0xc102, bloom);
+	ASSERT_RETURN(ret == 0);
+
+	ASSERT_RETURN(recv_cookie(conn_rules) == 0xc102);
+	ASSERT_RETURN(recv_cookie(conn_ids) == 0xc102);
+
+	/* removing other entries must keep the remaining ones working */
+	buf_id.cmd.size = sizeof(buf_id.cmd);
+	buf_id.cmd.cookie = 0x1d11;
+	ret = ioctl(conn_ids->fd, KDBUS_CMD_MATCH_REMOVE, &buf_id.cmd);
+	ASSERT_RETURN(ret == 0);
+
+	ret = send_bloom(env->conn, 0xc103, bloom);
+	ASSERT_RETURN(ret == 0);
+
+	ASSERT_RETURN(recv_cookie(conn_ids) == 0xc103);
+
+	free_conn(conn_rules);
+	free_conn(conn_ids);
+
+	return CHECK_OK;
+}
+
+static int check_match_name(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			char name[64];
+		} item;
+	} buf;
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conn;
+	uint64_t bloom[8] = {};
+	uint64_t size;
+	char *name;
+	int ret;
+
+	name = "foo.bla.match";
+	ret = upload_policy(env->conn->fd, name);
+	ASSERT_RETURN(ret == 0);
+
+	size = sizeof(*cmd_name) + strlen(name) + 1;
+	cmd_name = alloca(size);
+
+	memset(cmd_name, 0, size);
+	strcpy(cmd_name->name, name);
+	cmd_name->size = size;
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	/* match on messages from the owner of the name */
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.cmd.cookie = 0x4a00;
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_NAME;
+	strcpy(buf.item.name, name);
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	ret = send_bloom(env->conn, 0xc300, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0);
+
+	ret = ioctl(env->conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+
+	ret = send_bloom(env->conn, 0xc301, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0xc301);
+
+	/* rebuilding the database must keep the name of the entry intact */
+	buf.cmd.cookie = 0x4a01;
+	strcpy(buf.item.name, "foo.bla.other");
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	buf.cmd.size = sizeof(buf.cmd);
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_REMOVE, &buf.cmd);
+	ASSERT_RETURN(ret == 0);
+
+	ret = send_bloom(env->conn, 0xc302, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0xc302);
+
+	ret = ioctl(env->conn->fd, KDBUS_CMD_NAME_RELEASE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+
+	ret = send_bloom(env->conn, 0xc303, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_match_bloom_multi(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom[8];
+		} item;
+	} buf;
+	struct kdbus_conn *conn;
+	uint64_t bloom[8] = {};
+	unsigned int i;
+	int ret;
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	/* six entries, matched in a batch of four and one by one */
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_BLOOM;
+
+	for (i = 0; i < 6; i++) {
+		buf.cmd.cookie = 0xb200 + i;
+		memset(buf.item.bloom, 0, sizeof(buf.item.bloom));
+		buf.item.bloom[i] = 1ULL << i;
+		buf.item.bloom[7] = 1ULL << 63;
+		ret = ioctl(conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	/* the last word alone matches none of them */
+	bloom[7] = 1ULL << 63;
+	ret = send_bloom(env->conn, 0xc200, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0);
+
+	for (i = 0; i < 6; i++) {
+		memset(bloom, 0, sizeof(bloom));
+		bloom[i] = 1ULL << i;
+		bloom[7] = 1ULL << 63;
+		ret = send_bloom(env->conn, 0xc210 + i, bloom);
+		ASSERT_RETURN(ret == 0);
+		ASSERT_RETURN(recv_cookie(conn) == 0xc210 + i);
+
+		/* the bit of an entry in the wrong word does not match */
+		memset(bloom, 0, sizeof(bloom));
+		bloom[(i + 1) % 6] = 1ULL << i;
+		bloom[7] = 1ULL << 63;
+		ret = send_bloom(env->conn, 0xc220 + i, bloom);
+		ASSERT_RETURN(ret == 0);
+		ASSERT_RETURN(recv_cookie(conn) == 0);
+	}
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_match_stats(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_match cmd;
+		struct {
+			uint64_t size;
+			uint64_t type;
+			uint64_t bloom[8];
+		} item;
+	} buf;
+	struct kdbus_cmd_match_stats cmd;
+	struct kdbus_match_stats *stats;
+	struct kdbus_conn *conn;
+	uint64_t bloom[8] = {};
+	int ret;
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	memset(&buf, 0, sizeof(buf));
+	buf.cmd.size = sizeof(buf);
+	buf.item.size = sizeof(buf.item);
+	buf.item.type = KDBUS_ITEM_BLOOM;
+
+	/* one entry for bit 1, one for bits 2 and 3 */
+	buf.cmd.cookie = 0xd100;
+	buf.item.bloom[0] = 1ULL << 1;
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	buf.cmd.cookie = 0xd200;
+	buf.item.bloom[0] = 0;
+	buf.item.bloom[1] = 1ULL << 2;
+	buf.item.bloom[2] = 1ULL << 3;
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_ADD, &buf);
+	ASSERT_RETURN(ret == 0);
+
+	/* two hits of the first entry */
+	bloom[0] = 1ULL << 1;
+	ret = send_bloom(env->conn, 0xe100, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0xe100);
+
+	ret = send_bloom(env->conn, 0xe101, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0xe101);
+
+	/* a candidate for the second entry, which does not match */
+	bloom[0] = 0;
+	bloom[1] = 1ULL << 2;
+	ret = send_bloom(env->conn, 0xe200, bloom);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv_cookie(conn) == 0);
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.size = sizeof(cmd);
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_STATS, &cmd);
+	ASSERT_RETURN(ret == 0);
+
+	stats = (struct kdbus_match_stats *)(conn->buf + cmd.offset);
+	ASSERT_RETURN(stats->size == sizeof(*stats) +
+				     2 * sizeof(struct kdbus_match_entry_stats));
+	ASSERT_RETURN(stats->evaluated == 3);
+	ASSERT_RETURN(stats->matched == 2);
+
+	/* matching stops at the first entry which matches */
+	ASSERT_RETURN(stats->bloom_checked >= 4 && stats->bloom_checked <= 6);
+	ASSERT_RETURN(stats->bloom_hits == 2);
+	ASSERT_RETURN(stats->entries[0].cookie == 0xd100);
+	ASSERT_RETURN(stats->entries[0].hits == 2);
+	ASSERT_RETURN(stats->entries[1].cookie == 0xd200);
+	ASSERT_RETURN(stats->entries[1].hits == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &cmd.offset);
+	ASSERT_RETURN(ret == 0);
+
+	/* unknown flags are refused */
+	cmd.flags = 1ULL << 63;
+	ret = ioctl(conn->fd, KDBUS_CMD_MATCH_STATS, &cmd);
+	ASSERT_RETURN(ret < 0 && errno == EOPNOTSUPP);
+
+	free_conn(conn);
+
+	/* the bus keeps the counters of connections which are gone */
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.size = sizeof(cmd);
+	cmd.flags = KDBUS_MATCH_STATS_BUS;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MATCH_STATS, &cmd);
+	ASSERT_RETURN(ret == 0);
+
+	stats = (struct kdbus_match_stats *)(env->conn->buf + cmd.offset);
+	ASSERT_RETURN(stats->size == sizeof(*stats));
+	ASSERT_RETURN(stats->evaluated == 3);
+	ASSERT_RETURN(stats->matched == 2);
+
+	ret = ioctl(env->conn->fd, KDBUS_CMD_FREE, &cmd.offset);
+	ASSERT_RETURN(ret == 0);
+
+	return CHECK_OK;
+}
+
+static int check_msg_basic(struct kdbus_check_env *env)
+{
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	struct kdbus_item *item;
+	unsigned int vecs = 0;
+	uint64_t cookie = 0x1234abcd5678eeff;
+	struct pollfd fd;
+	struct kdbus_cmd_recv recv = {};
+	int ret;
+
+	/* create a 2nd connection */
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	add_match_empty(conn->fd);
+	add_match_empty(env->conn->fd);
+
+	/* send over 1st connection */
+	ret = send_message(env->conn, NULL, cookie, KDBUS_DST_ID_BROADCAST);
+	ASSERT_RETURN(ret == 0);
+
+	/* ... and receive on the 2nd */
+	fd.fd = conn->fd;
+	fd.events = POLLIN | POLLPRI | POLLHUP;
+	fd.revents = 0;
+
+	ret = poll(&fd, 1, 100);
+	ASSERT_RETURN(ret > 0 && (fd.revents & POLLIN));
+
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+	ASSERT_RETURN(ret == 0);
+
+	msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+	ASSERT_RETURN(msg->cookie == cookie);
+
+	/* the payload is staged in the kernel once for all receivers */
+	KDBUS_ITEM_FOREACH(item, msg, items) {
+		const char *data;
+
+		if (item->type != KDBUS_ITEM_PAYLOAD_OFF ||
+		    item->vec.offset == ~0ULL)
+			continue;
+
+		data = (const char *)msg + item->vec.offset;
+		if (vecs++ == 0) {
+			ASSERT_RETURN(memcmp(data, "0123456789_0", 12) == 0);
+		} else {
+			ASSERT_RETURN(memcmp(data, "0123456789_1", 12) == 0);
+		}
+	}
+
+	ASSERT_RETURN(vecs == 2);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+	ASSERT_RETURN(ret == 0);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_msg_recv_batch(struct kdbus_check_env *env)
+{
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	struct kdbus_cmd_recv_batch batch = {};
+	uint64_t cookie = 0x1234abcd5678eeff;
+	uint64_t offsets[4];
+	unsigned int i;
+	int ret;
+
+	/* create a 2nd connection */
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	/* an empty queue returns EAGAIN */
+	batch.count = ELEMENTSOF(offsets);
+	batch.offsets = (uintptr_t)offsets;
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV_BATCH, &batch);
+	ASSERT_RETURN(ret == -1 && errno == EAGAIN);
+
+	/* PEEK is not supported */
+	batch.flags = KDBUS_RECV_PEEK;
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV_BATCH, &batch);
+	ASSERT_RETURN(ret == -1 && errno == EINVAL);
+
+	/* queue three messages */
+	for (i = 0; i < 3; i++) {
+		ret = send_message(env->conn, NULL, cookie + i,
+				   conn->hello.id);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	/* ask for more than there is */
+	batch.flags = 0;
+	batch.count = ELEMENTSOF(offsets);
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV_BATCH, &batch);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(batch.count == 3);
+
+	for (i = 0; i < batch.count; i++) {
+		msg = (struct kdbus_msg *)(conn->buf + offsets[i]);
+		ASSERT_RETURN(msg->cookie == cookie + i);
+
+		ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[i]);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_msg_send_batch(struct kdbus_check_env *env)
+{
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	struct kdbus_msg msgs[3] = {};
+	struct kdbus_cmd_send_batch batch = {};
+	struct kdbus_cmd_recv_batch recv = {};
+	uint64_t cookie = 0x1234abcd5678eeff;
+	uint64_t ptrs[3], offsets[3];
+	int64_t results[3];
+	unsigned int i;
+	int ret;
+
+	/* create a 2nd connection */
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	for (i = 0; i < ELEMENTSOF(msgs); i++) {
+		msgs[i].size = sizeof(struct kdbus_msg);
+		msgs[i].src_id = env->conn->hello.id;
+		msgs[i].dst_id = conn->hello.id;
+		msgs[i].cookie = cookie + i;
+		msgs[i].payload_type = KDBUS_PAYLOAD_DBUS;
+		ptrs[i] = (uintptr_t)&msgs[i];
+	}
+
+	/* the 2nd message goes to an unknown peer */
+	msgs[1].dst_id = 0x12345678;
+
+	batch.count = ELEMENTSOF(msgs);
+	batch.msgs = (uintptr_t)ptrs;
+	batch.results = (uintptr_t)results;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MSG_SEND_BATCH, &batch);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(results[0] == 0);
+	ASSERT_RETURN(results[1] == -ENXIO);
+	ASSERT_RETURN(results[2] == 0);
+
+	recv.count = ELEMENTSOF(offsets);
+	recv.offsets = (uintptr_t)offsets;
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV_BATCH, &recv);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv.count == 2);
+
+	msg = (struct kdbus_msg *)(conn->buf + offsets[0]);
+	ASSERT_RETURN(msg->cookie == cookie);
+	msg = (struct kdbus_msg *)(conn->buf + offsets[1]);
+	ASSERT_RETURN(msg->cookie == cookie + 2);
+
+	for (i = 0; i < recv.count; i++) {
+		ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[i]);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	/* a misaligned message fails on its own, the others are sent */
+	msgs[1].dst_id = conn->hello.id;
+	ptrs[1] = (uintptr_t)&msgs[1] + 4;
+
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MSG_SEND_BATCH, &batch);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(results[0] == 0);
+	ASSERT_RETURN(results[1] == -EFAULT);
+	ASSERT_RETURN(results[2] == 0);
+
+	recv.count = ELEMENTSOF(offsets);
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV_BATCH, &recv);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(recv.count == 2);
+
+	for (i = 0; i < recv.count; i++) {
+		ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[i]);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_msg_send_batch_activator(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_hello hello;
+		uint64_t size;
+		uint64_t type;
+		char str[32];
+	} activator = {};
+	struct {
+		struct kdbus_msg msg;
+		uint64_t size;
+		uint64_t type;
+		char str[32];
+	} by_name = {};
+	struct kdbus_msg by_id = {};
+	struct kdbus_cmd_send_batch batch = {};
+	const char *name = "foo.test.activator";
+	uint64_t ptrs[2];
+	int64_t results[2];
+	int fd, ret;
+
+	fd = open(env->buspath, O_RDWR|O_CLOEXEC);
+	ASSERT_RETURN(fd >= 0);
+
+	activator.hello.size = sizeof(activator);
+	activator.hello.conn_flags = KDBUS_HELLO_ACTIVATOR;
+	activator.hello.pool_size = POOL_SIZE;
+	activator.size = KDBUS_ITEM_HEADER_SIZE + strlen(name) + 1;
+	activator.type = KDBUS_ITEM_NAME;
+	strcpy(activator.str, name);
+
+	ret = ioctl(fd, KDBUS_CMD_HELLO, &activator);
+	if (ret < 0 && errno == EPERM) {
+		close(fd);
+		return CHECK_SKIP;
+	}
+	ASSERT_RETURN(ret == 0);
+
+	ret = upload_policy(env->conn->fd, name);
+	ASSERT_RETURN(ret == 0);
+
+	by_name.size = KDBUS_ITEM_HEADER_SIZE + strlen(name) + 1;
+	by_name.type = KDBUS_ITEM_DST_NAME;
+	strcpy(by_name.str, name);
+	by_name.msg.size = sizeof(by_name.msg) + KDBUS_ALIGN8(by_name.size);
+	by_name.msg.src_id = env->conn->hello.id;
+	by_name.msg.dst_id = KDBUS_DST_ID_NAME;
+	by_name.msg.cookie = 0xa1;
+	by_name.msg.payload_type = KDBUS_PAYLOAD_DBUS;
+
+	/* the activator must not be reachable by its unique ID */
+	by_id.size = sizeof(by_id);
+	by_id.src_id = env->conn->hello.id;
+	by_id.dst_id = activator.hello.id;
+	by_id.cookie = 0xa2;
+	by_id.payload_type = KDBUS_PAYLOAD_DBUS;
+
+	/* the name resolves the activator first, the ID must still fail */
+	ptrs[0] = (uintptr_t)&by_name;
+	ptrs[1] = (uintptr_t)&by_id;
+
+	batch.count = ELEMENTSOF(ptrs);
+	batch.msgs = (uintptr_t)ptrs;
+	batch.results = (uintptr_t)results;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MSG_SEND_BATCH, &batch);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(results[0] == 0);
+	ASSERT_RETURN(results[1] == -ENXIO);
+
+	close(fd);
+
+	return CHECK_OK;
+}
+
+static int check_ring(struct kdbus_check_env *env)
+{
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	struct kdbus_msg m = {};
+	struct kdbus_cmd_ring ring = {};
+	struct kdbus_ring_ctl *sq, *cq;
+	struct kdbus_ring_sqe *sqes;
+	struct kdbus_ring_cqe *cqes;
+	uint64_t cookie = 0x1234abcd5678eeff;
+	struct pollfd fd;
+	void *mem;
+	int ret;
+
+	/* create a 2nd connection */
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	/* no rings set up yet */
+	ret = ioctl(conn->fd, KDBUS_CMD_RING_ENTER);
+	ASSERT_RETURN(ret == -1 && errno == ENXIO);
+
+	/* the number of entries must be a power of two */
+	ring.entries = 3;
+	ret = ioctl(conn->fd, KDBUS_CMD_RING_SETUP, &ring);
+	ASSERT_RETURN(ret == -1 && errno == EINVAL);
+
+	ring.entries = 4;
+	ret = ioctl(conn->fd, KDBUS_CMD_RING_SETUP, &ring);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(ring.offset == POOL_SIZE);
+
+	/* only one set of rings per connection */
+	ret = ioctl(conn->fd, KDBUS_CMD_RING_SETUP, &ring);
+	ASSERT_RETURN(ret == -1 && errno == EEXIST);
+
+	mem = mmap(NULL, ring.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   conn->fd, ring.offset);
+	ASSERT_RETURN(mem != MAP_FAILED);
+
+	sq = mem + ring.sq_off;
+	sqes = mem + ring.sqes_off;
+	cq = mem + ring.cq_off;
+	cqes = mem + ring.cqes_off;
+
+	/* queue a message from the 1st connection */
+	m.size = sizeof(struct kdbus_msg);
+	m.src_id = env->conn->hello.id;
+	m.dst_id = conn->hello.id;
+	m.cookie = cookie;
+	m.payload_type = KDBUS_PAYLOAD_DBUS;
+	ret = ioctl(env->conn->fd, KDBUS_CMD_MSG_SEND, &m);
+	ASSERT_RETURN(ret == 0);
+
+	/* submit a receive; poll() does not process it */
+	sqes[0].op = KDBUS_RING_OP_RECV;
+	sqes[0].user_data = 1;
+	sq->tail = 1;
+
+	fd.fd = conn->fd;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	ret = poll(&fd, 1, 0);
+	ASSERT_RETURN(ret > 0 && (fd.revents & POLLIN));
+	ASSERT_RETURN(sq->head == 0);
+	ASSERT_RETURN(cq->tail == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_RING_ENTER);
+	ASSERT_RETURN(ret == 1);
+
+	ASSERT_RETURN(sq->head == 1);
+	ASSERT_RETURN(cq->tail == 1);
+	ASSERT_RETURN(cqes[0].user_data == 1);
+	ASSERT_RETURN(cqes[0].result == 0);
+
+	msg = (struct kdbus_msg *)(conn->buf + cqes[0].offset);
+	ASSERT_RETURN(msg->cookie == cookie);
+
+	/* free the message, and submit an invalid operation */
+	sqes[1].op = KDBUS_RING_OP_FREE;
+	sqes[1].arg = cqes[0].offset;
+	sqes[1].user_data = 2;
+	sqes[2].op = 0xff;
+	sqes[2].user_data = 3;
+	sq->tail = 3;
+	cq->head = 1;
+
+	ret = ioctl(conn->fd, KDBUS_CMD_RING_ENTER);
+	ASSERT_RETURN(ret == 2);
+
+	ASSERT_RETURN(cq->tail == 3);
+	ASSERT_RETURN(cqes[1].user_data == 2);
+	ASSERT_RETURN(cqes[1].result == 0);
+	ASSERT_RETURN(cqes[2].user_data == 3);
+	ASSERT_RETURN(cqes[2].result == -EOPNOTSUPP);
+
+	munmap(mem, ring.size);
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_msg_free(struct kdbus_check_env *env)
+{
+	int ret;
+	uint64_t off = 0;
+
+	/* free an unallocated buffer */
+	ret = ioctl(env->conn->fd, KDBUS_CMD_FREE, &off);
 	ASSERT_RETURN(ret == -1 && errno == ENXIO);
 
 	/* free a buffer out of the pool's bounds */
@@ -1049,6 +2321,361 @@ static int check_msg_free(struct kdbus_check_env *env)
 	return CHECK_OK;
 }
 
+static int check_pool_fifo(struct kdbus_check_env *env)
+{
+	struct kdbus_cmd_recv recv = {};
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	uint64_t cookie = 0x1234abcd5678eeff;
+	uint64_t offsets[4];
+	unsigned int i;
+	int ret;
+
+	conn = make_conn(env->buspath, KDBUS_HELLO_POOL_FIFO);
+	ASSERT_RETURN(conn != NULL);
+
+	for (i = 0; i < ELEMENTSOF(offsets); i++) {
+		ret = send_message(env->conn, NULL, cookie + i,
+				   conn->hello.id);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	for (i = 0; i < ELEMENTSOF(offsets); i++) {
+		ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+		ASSERT_RETURN(ret == 0);
+
+		msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+		ASSERT_RETURN(msg->cookie == cookie + i);
+
+		/* messages are placed one after the other */
+		if (i > 0)
+			ASSERT_RETURN(recv.offset > offsets[i - 1]);
+
+		offsets[i] = recv.offset;
+	}
+
+	/* free the oldest message */
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[0]);
+	ASSERT_RETURN(ret == 0);
+
+	/* free out of order, which falls back to the slice allocator */
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[2]);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[2]);
+	ASSERT_RETURN(ret == -1 && errno == ENXIO);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[1]);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &offsets[3]);
+	ASSERT_RETURN(ret == 0);
+
+	/* the pool keeps working after the fallback */
+	ret = send_message(env->conn, NULL, cookie, conn->hello.id);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+	ASSERT_RETURN(ret == 0);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_pool_release(struct kdbus_check_env *env)
+{
+	struct kdbus_cmd_recv recv = {};
+	struct kdbus_conn *conn;
+	size_t page = sysconf(_SC_PAGESIZE);
+	unsigned char vec[(1024 * 1024) / 4096];
+	unsigned int i, resident = 0;
+	void *start;
+	int ret;
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	/* the message carries a 1 MiB payload */
+	ret = send_message(env->conn, NULL, 0xc0000000, conn->hello.id);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+	ASSERT_RETURN(ret == 0);
+
+	/* the pages of the freed region are not resident anymore */
+	start = conn->buf + ((recv.offset + page - 1) & ~(page - 1));
+	ret = mincore(start, 1024 * 1024, vec);
+	ASSERT_RETURN(ret == 0);
+
+	for (i = 0; i < (1024 * 1024) / page; i++)
+		if (vec[i] & 1)
+			resident++;
+
+	ASSERT_RETURN(resident == 0);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_activator_move(struct kdbus_check_env *env)
+{
+	struct {
+		struct kdbus_cmd_hello hello;
+		uint64_t size;
+		uint64_t type;
+		char str[32];
+	} activator = {};
+	struct kdbus_cmd_recv recv = {};
+	struct kdbus_cmd_name *cmd_name;
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	struct kdbus_item *item;
+	const char *name = "foo.test.activator";
+	unsigned int vecs = 0;
+	size_t size;
+	int fd, ret;
+
+	fd = open(env->buspath, O_RDWR|O_CLOEXEC);
+	ASSERT_RETURN(fd >= 0);
+
+	activator.hello.size = sizeof(activator);
+	activator.hello.conn_flags = KDBUS_HELLO_ACTIVATOR |
+				     KDBUS_HELLO_ACCEPT_FD;
+	activator.hello.pool_size = POOL_SIZE;
+	activator.size = KDBUS_ITEM_HEADER_SIZE + strlen(name) + 1;
+	activator.type = KDBUS_ITEM_NAME;
+	strcpy(activator.str, name);
+
+	ret = ioctl(fd, KDBUS_CMD_HELLO, &activator);
+	if (ret < 0 && errno == EPERM) {
+		close(fd);
+		return CHECK_SKIP;
+	}
+	ASSERT_RETURN(ret == 0);
+
+	ret = upload_policy(env->conn->fd, name);
+	ASSERT_RETURN(ret == 0);
+
+	/* queue a message with a 1 MiB payload on the activator */
+	ret = send_message(env->conn, name, 0xc0000000, 0);
+	ASSERT_RETURN(ret == 0);
+
+	conn = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn != NULL);
+
+	ret = upload_policy(conn->fd, name);
+	ASSERT_RETURN(ret == 0);
+
+	size = sizeof(*cmd_name) + strlen(name) + 1;
+	cmd_name = alloca(size);
+	memset(cmd_name, 0, size);
+	strcpy(cmd_name->name, name);
+	cmd_name->size = size;
+	cmd_name->flags = KDBUS_NAME_REPLACE_EXISTING;
+
+	/* taking the name moves the message to our pool */
+	ret = ioctl(conn->fd, KDBUS_CMD_NAME_ACQUIRE, cmd_name);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+	ASSERT_RETURN(ret == 0);
+
+	msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+	ASSERT_RETURN(msg->cookie == 0xc0000000);
+
+	/* all pages of the payload have been moved over */
+	KDBUS_ITEM_FOREACH(item, msg, items) {
+		const char *data;
+		uint64_t i;
+
+		if (item->type != KDBUS_ITEM_PAYLOAD_OFF ||
+		    item->vec.offset == ~0ULL)
+			continue;
+
+		data = (const char *)msg + item->vec.offset;
+
+		if (vecs++ == 0) {
+			ASSERT_RETURN(item->vec.size == 1024 * 1024 + 3);
+			ASSERT_RETURN(memcmp(data, "0123456789_0", 12) == 0);
+
+			for (i = 12; i < item->vec.size; i++)
+				ASSERT_RETURN(data[i] == 0);
+		} else {
+			ASSERT_RETURN(memcmp(data, "0123456789_1", 12) == 0);
+		}
+	}
+
+	ASSERT_RETURN(vecs == 2);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+	ASSERT_RETURN(ret == 0);
+
+	free_conn(conn);
+	close(fd);
+
+	return CHECK_OK;
+}
+
+static int check_pool_mapped(struct kdbus_check_env *env)
+{
+	struct kdbus_cmd_recv recv = {};
+	struct kdbus_cmd_hello hello = {};
+	struct kdbus_conn *conn;
+	struct kdbus_msg *msg;
+	struct kdbus_item *item;
+	unsigned int vecs = 0;
+	int fd, ret;
+
+	fd = open(env->buspath, O_RDWR|O_CLOEXEC);
+	ASSERT_RETURN(fd >= 0);
+
+	/* mapped pools are limited in size */
+	hello.conn_flags = KDBUS_HELLO_POOL_MAPPED;
+	hello.size = sizeof(struct kdbus_cmd_hello);
+	hello.pool_size = 1024LU * 1024LU * 1024LU;
+	ret = ioctl(fd, KDBUS_CMD_HELLO, &hello);
+	ASSERT_RETURN(ret == -1 && errno == EMSGSIZE);
+
+	close(fd);
+
+	conn = make_conn(env->buspath, KDBUS_HELLO_POOL_MAPPED);
+	ASSERT_RETURN(conn != NULL);
+
+	ret = send_message(env->conn, NULL, 0xc0000000, conn->hello.id);
+	ASSERT_RETURN(ret == 0);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+	ASSERT_RETURN(ret == 0);
+
+	msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+	ASSERT_RETURN(msg->cookie == 0xc0000000);
+
+	KDBUS_ITEM_FOREACH(item, msg, items) {
+		const char *data;
+
+		if (item->type != KDBUS_ITEM_PAYLOAD_OFF ||
+		    item->vec.offset == ~0ULL)
+			continue;
+
+		data = (const char *)msg + item->vec.offset;
+		if (vecs++ == 0) {
+			ASSERT_RETURN(memcmp(data, "0123456789_0", 12) == 0);
+		} else {
+			ASSERT_RETURN(memcmp(data, "0123456789_1", 12) == 0);
+		}
+	}
+
+	ASSERT_RETURN(vecs == 2);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+	ASSERT_RETURN(ret == 0);
+
+	free_conn(conn);
+
+	return CHECK_OK;
+}
+
+static int check_arena(struct kdbus_check_env *env)
+{
+	struct kdbus_cmd_arena cmd = {};
+	struct kdbus_conn *conn, *conn_copy;
+	const char *arena;
+	unsigned int i;
+	int ret;
+
+	conn = make_conn(env->buspath, 0);
+	conn_copy = make_conn(env->buspath, 0);
+	ASSERT_RETURN(conn && conn_copy);
+
+	ret = ioctl(conn->fd, KDBUS_CMD_ARENA_SETUP, &cmd);
+	ASSERT_RETURN(ret == 0);
+	ASSERT_RETURN(cmd.size > 0);
+
+	/* the arena is shared by all receivers, it cannot be written to */
+	arena = mmap(NULL, cmd.size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		     conn->fd, cmd.offset);
+	ASSERT_RETURN(arena == MAP_FAILED);
+
+	arena = mmap(NULL, cmd.size, PROT_READ, MAP_SHARED,
+		     conn->fd, cmd.offset);
+	ASSERT_RETURN(arena != MAP_FAILED);
+
+	add_match_empty(conn->fd);
+	add_match_empty(conn_copy->fd);
+
+	/*
+	 * Send more payload than fits into the arena at once; the data
+	 * must be released when the receivers free their messages.
+	 */
+	for (i = 0; i < 32; i++) {
+		struct kdbus_cmd_recv recv = {};
+		struct kdbus_item *item;
+		struct kdbus_msg *msg;
+		unsigned int vecs = 0;
+
+		ret = send_message(env->conn, NULL, 0xa000 + i,
+				   KDBUS_DST_ID_BROADCAST);
+		ASSERT_RETURN(ret == 0);
+
+		/* the receiver with the arena mapped */
+		ret = ioctl(conn->fd, KDBUS_CMD_MSG_RECV, &recv);
+		ASSERT_RETURN(ret == 0);
+
+		msg = (struct kdbus_msg *)(conn->buf + recv.offset);
+		ASSERT_RETURN(msg->cookie == 0xa000 + i);
+
+		KDBUS_ITEM_FOREACH(item, msg, items) {
+			const char *data;
+
+			ASSERT_RETURN(item->type != KDBUS_ITEM_PAYLOAD_OFF);
+			if (item->type != KDBUS_ITEM_PAYLOAD_ARENA ||
+			    item->vec.offset == ~0ULL)
+				continue;
+
+			ASSERT_RETURN(item->vec.offset + item->vec.size <=
+				      cmd.size);
+
+			data = arena + item->vec.offset;
+			if (vecs++ == 0) {
+				ASSERT_RETURN(memcmp(data, "0123456789_0", 12) == 0);
+			} else {
+				ASSERT_RETURN(memcmp(data, "0123456789_1", 12) == 0);
+			}
+		}
+
+		ASSERT_RETURN(vecs == 2);
+
+		ret = ioctl(conn->fd, KDBUS_CMD_FREE, &recv.offset);
+		ASSERT_RETURN(ret == 0);
+
+		/* the receiver without gets a copy in its pool */
+		memset(&recv, 0, sizeof(recv));
+		ret = ioctl(conn_copy->fd, KDBUS_CMD_MSG_RECV, &recv);
+		ASSERT_RETURN(ret == 0);
+
+		msg = (struct kdbus_msg *)(conn_copy->buf + recv.offset);
+		KDBUS_ITEM_FOREACH(item, msg, items)
+			ASSERT_RETURN(item->type != KDBUS_ITEM_PAYLOAD_ARENA);
+
+		ret = ioctl(conn_copy->fd, KDBUS_CMD_FREE, &recv.offset);
+		ASSERT_RETURN(ret == 0);
+	}
+
+	munmap((void *)arena, cmd.size);
+	free_conn(conn);
+	free_conn(conn_copy);
+
+	return CHECK_OK;
+}
+
 /* -----------------------------------8<------------------------------- */
 
 static int check_prepare_env(const struct kdbus_check *c, struct kdbus_check_env *env)
@@ -1081,6 +2708,9 @@ static int check_prepare_env(const struct kdbus_check *c, struct kdbus_check_env
 		bus_make.bs.type = KDBUS_ITEM_BLOOM_SIZE;
 		bus_make.bs.bloom_size = 64;
 
+		if (c->flags & CHECK_CREATE_ARENA)
+			bus_make.head.flags = KDBUS_MAKE_ARENA;
+
 		for (i = 0; i < sizeof(n); i++)
 			n[i] = 'a' + (random() % ('z' - 'a'));
 
@@ -1135,14 +2765,35 @@ static const struct kdbus_check checks[] = {
 	{ "name basics",	check_name_basic,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "name conflict",	check_name_conflict,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "name queue",		check_name_queue,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "name queue replace",	check_name_queue_replace,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "name send",		check_name_send,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "conn id lookup",	check_conn_id_lookup,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "name list batch",	check_name_list_batch,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "message basic",	check_msg_basic,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "message recv batch",	check_msg_recv_batch,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "message send batch",	check_msg_send_batch,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "message send batch activator", check_msg_send_batch_activator, CHECK_CREATE_BUS | CHECK_CREATE_CONN },
+	{ "ring",		check_ring,			CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "message free",	check_msg_free,			CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "pool fifo",		check_pool_fifo,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "pool release",	check_pool_release,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "pool mapped",	check_pool_mapped,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "arena",		check_arena,			CHECK_CREATE_BUS | CHECK_CREATE_CONN | CHECK_CREATE_ARENA },
+	{ "activator move",	check_activator_move,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "connection info",	check_conn_info,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "match id add",	check_match_id_add,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "match id remove",	check_match_id_remove,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match id index",	check_match_id_remove_index,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match notify batch",	check_match_notify_batch,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match stats",	check_match_stats,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "match name add",	check_match_name_add,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "match name remove",	check_match_name_remove,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "match name change",	check_match_name_change,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match name atom",	check_match_name_atom,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match bloom",	check_match_bloom,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match rules",	check_match_rules,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match bloom multi",	check_match_bloom_multi,	CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
+	{ "match name",		check_match_name,		CHECK_CREATE_BUS | CHECK_CREATE_CONN	},
 	{ "ns make",		check_nsmake,			0					},
 	{ NULL, NULL, 0 }
 };